@@ -0,0 +1,142 @@
+#include "metadata_shm.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+struct mc_shm_ring
+{
+    mc_shm_header* header;
+    uint8_t* data;
+    size_t size;
+};
+
+_Static_assert(sizeof(mc_shm_header) == MC_SHM_HEADER_SIZE, "mc_shm_header layout");
+_Static_assert(sizeof(mc_shm_record_header) == MC_SHM_RECORD_HEADER_SIZE, "mc_shm_record_header layout");
+
+static uint32_t align(uint32_t size)
+{
+    return (size + MC_SHM_RECORD_ALIGNMENT - 1) & ~(MC_SHM_RECORD_ALIGNMENT - 1);
+}
+
+/* Waits until space_futex differs from value or timeout_ms elapses. */
+static void wait_for_space(mc_shm_header* header, uint32_t value, int timeout_ms)
+{
+#ifdef __linux__
+    struct timespec timeout = { timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000L };
+    syscall(SYS_futex, &header->space_futex, FUTEX_WAIT, value, &timeout, NULL, 0);
+#else
+    (void)header;
+    (void)value;
+    struct timespec pause = { 0, timeout_ms < 1 ? 0 : 1000000L };
+    nanosleep(&pause, NULL);
+#endif
+}
+
+mc_shm_ring* mc_shm_open(const char* name)
+{
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) return NULL;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < MC_SHM_HEADER_SIZE)
+    {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    void* memory = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) return NULL;
+
+    mc_shm_header* header = (mc_shm_header*)memory;
+    if (header->magic != MC_SHM_MAGIC || header->version != MC_SHM_VERSION
+        || (size_t)info.st_size < MC_SHM_HEADER_SIZE + (size_t)header->capacity)
+    {
+        munmap(memory, (size_t)info.st_size);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    mc_shm_ring* ring = (mc_shm_ring*)malloc(sizeof(mc_shm_ring));
+    if (!ring)
+    {
+        munmap(memory, (size_t)info.st_size);
+        return NULL;
+    }
+
+    ring->header = header;
+    ring->data = (uint8_t*)memory + MC_SHM_HEADER_SIZE;
+    ring->size = (size_t)info.st_size;
+    return ring;
+}
+
+void mc_shm_close(mc_shm_ring* ring)
+{
+    if (!ring) return;
+
+    munmap(ring->header, ring->size);
+    free(ring);
+}
+
+int mc_shm_write(mc_shm_ring* ring, uint8_t schema_id, uint8_t schema_version, int64_t time_us,
+                 const void* payload, uint32_t size, int timeout_ms)
+{
+    mc_shm_header* header = ring->header;
+    const uint32_t capacity = header->capacity;
+
+    if (size > header->max_payload) return -EMSGSIZE;
+
+    const uint32_t needed = align(MC_SHM_RECORD_HEADER_SIZE + size);
+    uint64_t pos = __atomic_load_n(&header->write_pos, __ATOMIC_RELAXED);
+    const uint32_t contiguous = capacity - (uint32_t)(pos & (capacity - 1));
+    const uint32_t total = needed + (contiguous < needed ? contiguous : 0);
+
+    const int64_t deadline = mc_shm_now_us() + (int64_t)timeout_ms * 1000;
+    for (;;)
+    {
+        const uint32_t futex = __atomic_load_n(&header->space_futex, __ATOMIC_ACQUIRE);
+        const uint64_t read_pos = __atomic_load_n(&header->read_pos, __ATOMIC_ACQUIRE);
+        if (capacity - (pos - read_pos) >= total) break;
+
+        const int64_t remaining_ms = (deadline - mc_shm_now_us()) / 1000;
+        if (remaining_ms <= 0) return -EAGAIN;
+
+        __atomic_store_n(&header->producer_waiting, 1, __ATOMIC_SEQ_CST);
+        wait_for_space(header, futex, (int)remaining_ms);
+        __atomic_store_n(&header->producer_waiting, 0, __ATOMIC_RELAXED);
+    }
+
+    if (contiguous < needed)
+    {
+        mc_shm_record_header padding = { contiguous - MC_SHM_RECORD_HEADER_SIZE, 0, 0, MC_SHM_FLAG_PADDING, 0 };
+        memcpy(ring->data + (pos & (capacity - 1)), &padding, sizeof(padding));
+        pos += contiguous;
+    }
+
+    mc_shm_record_header record = { size, schema_id, schema_version, 0, time_us };
+    uint8_t* out = ring->data + (pos & (capacity - 1));
+    memcpy(out, &record, sizeof(record));
+    memcpy(out + MC_SHM_RECORD_HEADER_SIZE, payload, size);
+
+    __atomic_store_n(&header->write_pos, pos + needed, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int64_t mc_shm_now_us(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
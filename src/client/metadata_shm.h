@@ -0,0 +1,83 @@
+/* Client library writing metadata records into the shared memory ring of a
+ * metadata publisher running on the same host (provider "shm"). Plain C so
+ * it can be loaded from Python (ctypes), C# (P/Invoke), ... POSIX only.
+ *
+ * The publisher creates the ring, named METADATA_SHM_NAME, when it starts:
+ *
+ *   [header:256 bytes][data:capacity bytes]
+ *
+ * and a single producer process writes records into it:
+ *
+ *   [length:u32][schema_id:u8][schema_version:u8][flags:u16][time_us:i64][payload][padding to 16]
+ *
+ * in host byte order. write_pos and read_pos count the bytes written and
+ * consumed since the creation; the producer only moves write_pos, the
+ * publisher only read_pos. A record never wraps: when it does not fit before
+ * the end of the data, the producer fills the end with a padding record and
+ * starts again at offset 0. When the ring is full, a producer may wait on
+ * space_futex, which the publisher bumps and wakes each time it frees space.
+ */
+#ifndef METADATA_SHM_H
+#define METADATA_SHM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MC_SHM_MAGIC 0x4D435348u /* "MCSH" */
+#define MC_SHM_VERSION 1u
+#define MC_SHM_HEADER_SIZE 256u
+#define MC_SHM_RECORD_HEADER_SIZE 16u
+#define MC_SHM_RECORD_ALIGNMENT 16u
+#define MC_SHM_FLAG_PADDING 1u
+
+typedef struct mc_shm_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;        /* bytes of data, a power of two */
+    uint32_t max_payload;     /* largest payload accepted */
+    uint8_t reserved0[48];
+    uint64_t write_pos;       /* cache line of the producer */
+    uint8_t reserved1[56];
+    uint64_t read_pos;        /* cache line of the publisher */
+    uint8_t reserved2[56];
+    uint32_t space_futex;     /* bumped when read_pos moves */
+    uint32_t producer_waiting;
+    uint8_t reserved3[56];
+} mc_shm_header;
+
+typedef struct mc_shm_record_header
+{
+    uint32_t length;          /* payload bytes */
+    uint8_t schema_id;
+    uint8_t schema_version;
+    uint16_t flags;
+    int64_t time_us;          /* CLOCK_MONOTONIC, 0 for "now" */
+} mc_shm_record_header;
+
+typedef struct mc_shm_ring mc_shm_ring;
+
+/* Attaches to the ring of a running publisher. Returns NULL, with errno set,
+ * when it does not exist or is not a metadata ring. */
+mc_shm_ring* mc_shm_open(const char* name);
+
+void mc_shm_close(mc_shm_ring* ring);
+
+/* Copies a record into the ring. Waits up to timeout_ms for space when the
+ * ring is full, 0 to never wait. Returns 0, -EMSGSIZE when payload is larger
+ * than the ring accepts or -EAGAIN when it is still full. Not thread-safe:
+ * one producer per ring. */
+int mc_shm_write(mc_shm_ring* ring, uint8_t schema_id, uint8_t schema_version, int64_t time_us,
+                 const void* payload, uint32_t size, int timeout_ms);
+
+/* Current CLOCK_MONOTONIC time, the clock of time_us. */
+int64_t mc_shm_now_us(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* METADATA_SHM_H */
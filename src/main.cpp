@@ -2,15 +2,42 @@
 #include <stdexcept>
 #include <sstream>
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <thread>
+#include <vector>
 
 #include <millicast-sdk/publisher.h>
 #include <millicast-sdk/media.h>
+#include <millicast-sdk/stats.h>
 
-std::string get_env(const char* var) 
-{
-    const char* ret = std::getenv(var);
-    return (ret) ? ret : "";
-}
+#include "metadata/async_provider.h"
+#include "metadata/budget_scheduler.h"
+#include "metadata/compression.h"
+#include "metadata/deadband.h"
+#include "metadata/delta.h"
+#include "metadata/encryption.h"
+#include "metadata/fragment.h"
+#include "metadata/frame_memo.h"
+#include "metadata/position.h"
+#include "metadata/provider.h"
+#include "metadata/quantized.h"
+#include "metadata/redundancy.h"
+#include "metadata/rtp_clock.h"
+#include "metadata/sample_history.h"
+#include "metadata/sample_ring.h"
+#include "metadata/sensor_batch.h"
+#include "metadata/state_sync.h"
+#include "metadata/trailer.h"
+#include "metadata/versioning.h"
+
+using metadata::get_env;
 
 const millicast::Publisher::Credentials& get_stream_credentials() 
 {
@@ -28,17 +55,388 @@ const millicast::Publisher::Credentials& get_stream_credentials()
     return credentials;
 }
 
+enum class MetadataEncoding
+{
+    FIXED, // big-endian int32 fields
+    DELTA, // zigzag varint deltas with periodic keyframes
+    STATE_SYNC, // periodic snapshots, changed fields only in between
+    NORMALIZED, // [0, 1] coordinates quantized to position_bits
+};
+
+struct MetadataOptions
+{
+    bool legacy_layout; // raw pos_x/pos_y without trailer, for old players
+    MetadataEncoding encoding;
+    uint32_t keyframe_interval; // frames between keyframes / snapshots
+    std::chrono::milliseconds snapshot_period;
+    uint8_t position_bits; // bits per coordinate with the normalized encoding
+    bool interpolate; // between the samples around the capture time, or hold the last one
+    uint32_t redundancy_max_depth; // 0 disables the redundancy
+    std::size_t fragment_budget; // bytes of large messages sent per frame
+    bool crc; // CRC32C at the end of every block
+    std::vector<std::pair<uint8_t, std::vector<uint8_t>>> keys; // AES-GCM keys by id
+    std::optional<uint8_t> key_id; // active key, encryption is off without it
+    bool compression;
+    std::shared_ptr<const metadata::Dictionary> dictionary; // may be null
+    std::vector<std::shared_ptr<metadata::MetadataProvider>> providers; // extra blocks, in order
+    std::vector<metadata::Priority> provider_priorities; // of each provider
+    std::vector<std::string> provider_names; // of each provider
+    std::vector<std::pair<std::string, std::shared_ptr<metadata::AsyncProvider>>> async_providers; // by name, also in providers
+    std::size_t frame_budget; // bytes of metadata per frame, 0 for no limit
+    bool change_only; // UNCHANGED_MARKER instead of the blocks when nothing moved
+    std::vector<double> deadbands; // of pos_x and pos_y
+    std::chrono::milliseconds keepalive; // longest time without the values with change_only
+};
+
+std::vector<uint8_t> parse_hex(const std::string& hex)
+{
+    if (hex.size() % 2) throw std::runtime_error("Invalid hexadecimal string " + hex);
+
+    std::vector<uint8_t> bytes;
+    for (std::size_t i = 0; i < hex.size(); i += 2)
+    {
+        bytes.push_back(static_cast<uint8_t>(std::stoul(hex.substr(i, 2), nullptr, 16)));
+    }
+    return bytes;
+}
+
+std::vector<std::string> split_list(const std::string& value)
+{
+    std::vector<std::string> items;
+    std::istringstream iss(value);
+
+    for (std::string item; std::getline(iss, item, ',');)
+    {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+// Parses "id:hexkey,id:hexkey,..."
+std::vector<std::pair<uint8_t, std::vector<uint8_t>>> parse_keys(const std::string& value)
+{
+    std::vector<std::pair<uint8_t, std::vector<uint8_t>>> keys;
+    std::istringstream iss(value);
+
+    for (std::string entry; std::getline(iss, entry, ',');)
+    {
+        const auto colon = entry.find(':');
+        if (colon == std::string::npos) throw std::runtime_error("Invalid METADATA_KEYS entry " + entry);
+
+        auto key = parse_hex(entry.substr(colon + 1));
+        if (key.size() != 16 && key.size() != 32) throw std::runtime_error("METADATA_KEYS must be 128 or 256-bit keys.");
+
+        keys.emplace_back(static_cast<uint8_t>(std::stoul(entry.substr(0, colon))), std::move(key));
+    }
+    return keys;
+}
+
+// Parses "2" for every field, or "pos_x:2,pos_y:4". Deadbands must be finite
+// and not negative: NaN would hide every move until the keep-alive.
+std::vector<double> parse_deadbands(const std::string& value)
+{
+    std::vector<double> deadbands;
+    if (value.find(':') == std::string::npos)
+    {
+        deadbands = { std::stod(value) };
+    }
+    else
+    {
+        deadbands.assign(2, 0.0);
+        for (const auto& entry : split_list(value))
+        {
+            const auto colon = entry.find(':');
+            const auto field = entry.substr(0, colon);
+            if (colon == std::string::npos || (field != "pos_x" && field != "pos_y"))
+            {
+                throw std::runtime_error("Invalid METADATA_DEADBAND entry " + entry);
+            }
+            deadbands[field == "pos_x" ? 0 : 1] = std::stod(entry.substr(colon + 1));
+        }
+    }
+
+    if (std::ranges::any_of(deadbands, [](double deadband) { return !(deadband >= 0) || !std::isfinite(deadband); }))
+    {
+        throw std::runtime_error("Invalid METADATA_DEADBAND " + value);
+    }
+    return deadbands;
+}
+
+// Parses "name:ms,name:ms,..." into the deadline of each provider.
+std::map<std::string, std::chrono::microseconds> parse_async_providers(const std::string& value)
+{
+    std::map<std::string, std::chrono::microseconds> deadlines;
+    for (const auto& entry : split_list(value))
+    {
+        const auto colon = entry.find(':');
+        if (colon == std::string::npos) throw std::runtime_error("Invalid METADATA_ASYNC_PROVIDERS entry " + entry);
+
+        // Checked once converted: a deadline under 1 us would miss every frame.
+        const auto ms = std::stod(entry.substr(colon + 1));
+        const std::chrono::microseconds deadline{ std::isfinite(ms) && ms > 0 && ms < 1e9 ? static_cast<int64_t>(ms * 1000) : 0 };
+        if (deadline.count() <= 0) throw std::runtime_error("Invalid METADATA_ASYNC_PROVIDERS deadline " + entry + ", from 0.001 ms");
+        deadlines[entry.substr(0, colon)] = deadline;
+    }
+    return deadlines;
+}
+
+MetadataEncoding get_metadata_encoding(const std::string& name)
+{
+    if (name.empty() || name == "fixed") return MetadataEncoding::FIXED;
+    if (name == "delta") return MetadataEncoding::DELTA;
+    if (name == "sync") return MetadataEncoding::STATE_SYNC;
+    if (name == "normalized") return MetadataEncoding::NORMALIZED;
+
+    throw std::runtime_error("Unknown METADATA_ENCODING " + name);
+}
+
+bool get_sampling_interpolates(const std::string& name)
+{
+    if (name.empty() || name == "interpolate") return true;
+    if (name == "hold") return false;
+
+    throw std::runtime_error("Unknown METADATA_SAMPLING " + name);
+}
+
+MetadataOptions get_metadata_options()
+{
+    MetadataOptions options{
+      .legacy_layout = get_env("METADATA_LEGACY_LAYOUT") == "1",
+      .encoding = get_metadata_encoding(get_env("METADATA_ENCODING")),
+      .keyframe_interval = 30,
+      .snapshot_period = std::chrono::milliseconds{ 1000 },
+      .position_bits = 16,
+      .interpolate = get_sampling_interpolates(get_env("METADATA_SAMPLING")),
+      .redundancy_max_depth = 0,
+      .fragment_budget = 1024,
+      .crc = get_env("METADATA_CRC") != "0",
+      .keys = parse_keys(get_env("METADATA_KEYS")),
+      .key_id = std::nullopt,
+      .compression = get_env("METADATA_COMPRESSION") == "1",
+      .dictionary = nullptr,
+      .providers = {},
+      .provider_priorities = {},
+      .provider_names = {},
+      .async_providers = {},
+      .frame_budget = 0,
+      .change_only = false,
+      .deadbands = {},
+      .keepalive = std::chrono::milliseconds{ 1000 },
+    };
+
+    auto& registry = metadata::ProviderRegistry::instance();
+    for (const auto& path : split_list(get_env("METADATA_PROVIDER_LIBRARIES")))
+    {
+        registry.load_library(path);
+    }
+    const auto names = split_list(get_env("METADATA_PROVIDERS"));
+    const auto critical = split_list(get_env("METADATA_CRITICAL_PROVIDERS"));
+    const auto deadlines = parse_async_providers(get_env("METADATA_ASYNC_PROVIDERS"));
+    for (const auto& name : names)
+    {
+        std::shared_ptr<metadata::MetadataProvider> provider = registry.create(name);
+        if (auto deadline = deadlines.find(name); deadline != deadlines.end())
+        {
+            auto async = std::make_shared<metadata::AsyncProvider>(std::move(provider), deadline->second);
+            options.async_providers.emplace_back(name, async);
+            provider = std::move(async);
+        }
+        options.providers.push_back(std::move(provider));
+        options.provider_priorities.push_back(std::ranges::find(critical, name) != critical.end()
+            ? metadata::Priority::CRITICAL : metadata::Priority::BEST_EFFORT);
+        options.provider_names.push_back(name);
+    }
+    for (const auto& name : critical)
+    {
+        if (std::ranges::find(names, name) == names.end())
+        {
+            throw std::runtime_error("METADATA_CRITICAL_PROVIDERS lists " + name + " which is not in METADATA_PROVIDERS.");
+        }
+    }
+    for (const auto& [name, deadline] : deadlines)
+    {
+        if (std::ranges::find(names, name) == names.end())
+        {
+            throw std::runtime_error("METADATA_ASYNC_PROVIDERS lists " + name + " which is not in METADATA_PROVIDERS.");
+        }
+    }
+
+    if (auto path = get_env("METADATA_DICTIONARY"); !path.empty())
+    {
+        options.dictionary = std::make_shared<const metadata::Dictionary>(metadata::load_dictionary(path));
+        options.compression = true;
+    }
+
+    if (auto key_id = get_env("METADATA_KEY_ID"); !key_id.empty())
+    {
+        const auto id = std::stoul(key_id);
+        if (std::ranges::find(options.keys, id, [](const auto& key) { return key.first; }) == options.keys.end())
+        {
+            throw std::runtime_error("METADATA_KEY_ID " + key_id + " is not in METADATA_KEYS.");
+        }
+        options.key_id = static_cast<uint8_t>(id);
+    }
+    else if (!options.keys.empty())
+    {
+        options.key_id = options.keys.front().first;
+    }
+
+    if (auto interval = get_env("METADATA_KEYFRAME_INTERVAL"); !interval.empty())
+    {
+        options.keyframe_interval = static_cast<uint32_t>(std::stoul(interval));
+    }
+
+    if (auto period = get_env("METADATA_SNAPSHOT_MS"); !period.empty())
+    {
+        options.snapshot_period = std::chrono::milliseconds{ std::stoul(period) };
+    }
+
+    if (auto bits = get_env("METADATA_POSITION_BITS"); !bits.empty())
+    {
+        const auto value = std::stoul(bits);
+        if (value < 1 || value > 24) throw std::runtime_error("METADATA_POSITION_BITS must be between 1 and 24.");
+        options.position_bits = static_cast<uint8_t>(value);
+    }
+
+    if (auto depth = get_env("METADATA_REDUNDANCY"); !depth.empty())
+    {
+        options.redundancy_max_depth = static_cast<uint32_t>(std::min(std::stoul(depth), 255ul - 1));
+    }
+
+    if (auto budget = get_env("METADATA_FRAGMENT_BUDGET"); !budget.empty())
+    {
+        options.fragment_budget = std::stoul(budget);
+    }
+
+    if (auto budget = get_env("METADATA_FRAME_BUDGET"); !budget.empty())
+    {
+        options.frame_budget = std::stoul(budget);
+    }
+
+    if (auto deadband = get_env("METADATA_DEADBAND"); !deadband.empty())
+    {
+        options.change_only = true;
+        options.deadbands = parse_deadbands(deadband);
+    }
+
+    if (auto keepalive = get_env("METADATA_KEEPALIVE_MS"); !keepalive.empty())
+    {
+        options.keepalive = std::chrono::milliseconds{ std::stoul(keepalive) };
+    }
+
+    if (options.legacy_layout && (options.encoding != MetadataEncoding::FIXED || options.redundancy_max_depth || options.key_id || !options.providers.empty() || options.change_only))
+    {
+        throw std::runtime_error("METADATA_LEGACY_LAYOUT only supports the fixed encoding without redundancy, encryption, providers nor deadband.");
+    }
+
+    return options;
+}
+
+// Serialized blocks of one capture timestamp, before encryption and footer.
+struct FrameMetadata
+{
+    bool unchanged{ false }; // only UNCHANGED_MARKER is sent
+    std::vector<uint8_t> position;
+    uint8_t position_flags{ metadata::flags::NONE };
+    std::vector<uint8_t> sensors; // empty when no sensor sample arrived
+    uint8_t sensor_flags{ metadata::flags::NONE };
+    std::vector<uint8_t> providers; // blocks of the providers, back to back
+    std::vector<std::pair<std::size_t, uint8_t>> provider_blocks; // size and flags of each
+    std::vector<uint8_t> fragments; // empty when no message is pending
+    uint8_t fragment_flags{ metadata::flags::NONE };
+};
+
+// Position pushed by a producer thread, with the time it was measured.
+struct PositionSample
+{
+    std::chrono::steady_clock::time_point capture_time;
+    int32_t pos_x;
+    int32_t pos_y;
+};
+
+// Provider block of the frame being computed, until the budget is shared.
+struct ProviderBlock
+{
+    std::size_t provider;
+    std::size_t request; // in the BudgetScheduler
+};
+
+// Accelerometer and gyroscope XYZ.
+using ImuSample = metadata::SensorSample<6>;
+
 class MetadataPublisher : public millicast::Publisher::Listener
 {
     std::unique_ptr<millicast::Publisher> _publisher{ nullptr };
+    MetadataOptions _options;
+    metadata::DeltaEncoder _delta_encoder;
+    metadata::StateSyncEncoder _state_sync_encoder;
+    metadata::QuantizedEncoder _quantized_encoder;
+    metadata::RedundancyEncoder _redundancy_encoder;
+    metadata::RedundancyController _redundancy_controller;
+    std::vector<uint8_t> _sample; // payload of the current frame when redundancy is on
+    metadata::Fragmenter _fragmenter;
+    metadata::MetadataEncryptor _encryptor;
+    std::optional<metadata::Compressor> _compressor;
+    std::vector<uint8_t> _compressed;
+    std::vector<uint8_t> _block; // provider block being serialized
+    std::size_t _max_provider_size{ 0 }; // all the provider blocks of a frame
+    std::optional<metadata::DeadbandFilter> _deadband; // with change_only
+    std::vector<std::vector<uint8_t>> _provider_sent; // payload of the last block of each provider sent, with change_only
+    std::vector<std::vector<uint8_t>> _provider_payloads; // of the frame being computed, with change_only
+    metadata::BudgetScheduler _scheduler;
+    std::size_t _position_source, _sensor_source, _fragment_source;
+    std::vector<std::size_t> _provider_sources; // by provider
+    std::vector<ProviderBlock> _frame_providers; // of the frame being computed, like FrameMetadata::provider_blocks
+    metadata::TimestampMemo<FrameMetadata> _frame_memo;
+    metadata::SampleRing<PositionSample, 64> _samples;
+    metadata::SampleHistory<PositionSample, 128> _history;
+    metadata::RtpClock _rtp_clock;
+    metadata::SampleRing<ImuSample, 256> _imu_samples;
+    metadata::SensorBatch<6, 256> _imu_batch{ IMU_SENSOR_ID };
+    std::atomic<uint64_t> _imu_deferred{ 0 }; // samples left for a later frame, once per frame
     int32_t width, height;
-    int32_t pos_x, pos_y;
-    int8_t dir_x, dir_y;
+    int32_t pos_x, pos_y; // latest position drained from _samples
+    std::jthread _ball; // last, stops before the members it uses go away
+
+    static constexpr std::size_t MAX_PENDING_MESSAGE_BYTES = 4 * 1024 * 1024;
+    static constexpr std::size_t MIN_COMPRESSED_SIZE = 64; // smaller blocks are never worth it
+    static constexpr uint8_t IMU_SENSOR_ID = 0;
 
 public:
 
-    MetadataPublisher() noexcept : pos_x{0}, pos_y{0}, dir_x{1}, dir_y{ 1 }
+    MetadataPublisher(const MetadataOptions& options) noexcept : _options{options}, _delta_encoder{options.keyframe_interval},
+        _state_sync_encoder{options.keyframe_interval, options.snapshot_period},
+        _quantized_encoder{{ .coordinate_bits = options.position_bits }},
+        _redundancy_encoder{options.redundancy_max_depth}, _redundancy_controller{options.redundancy_max_depth},
+        _fragmenter{options.fragment_budget, MAX_PENDING_MESSAGE_BYTES}, _scheduler{options.frame_budget},
+        _position_source{_scheduler.add_source(metadata::Priority::CRITICAL)},
+        _sensor_source{_scheduler.add_source(metadata::Priority::BEST_EFFORT)},
+        _fragment_source{_scheduler.add_source(metadata::Priority::BEST_EFFORT)}, pos_x{0}, pos_y{0}
     {
+        for (const auto priority : options.provider_priorities)
+        {
+            _provider_sources.push_back(_scheduler.add_source(priority));
+        }
+
+        if (options.compression)
+        {
+            _compressor.emplace(options.dictionary);
+        }
+
+        if (options.change_only)
+        {
+            _deadband.emplace(options.deadbands, options.keepalive);
+        }
+
+        for (const auto& [id, key] : options.keys)
+        {
+            _encryptor.add_key(id, key);
+        }
+        if (options.key_id)
+        {
+            _encryptor.set_active_key(*options.key_id);
+        }
+
         _publisher = millicast::Publisher::create();
         _publisher->set_listener(this);
     }
@@ -52,11 +450,7 @@ public:
         auto video_track = video_source->start_capture();
         auto credentials = get_stream_credentials();
 
-        _publisher->set_credentials(credentials);
-        _publisher->add_track(video_track);
-        _publisher->enable_frame_transformer(true);
-        _publisher->connect();
-
+        // Before connecting, the frames use the capture format.
         auto cap = video_source->capability();
         width = cap.width;
         height = cap.height;
@@ -64,7 +458,88 @@ public:
         pos_x = width / 2;
         pos_y = height / 2;
 
+        prepare_providers({ width, height, cap.fps });
+
+        _publisher->set_credentials(credentials);
+        _publisher->add_track(video_track);
+        _publisher->enable_frame_transformer(true);
+        _publisher->enable_stats(_options.redundancy_max_depth > 0);
+        _publisher->connect();
+
+        _ball = std::jthread([this, fps = cap.fps](std::stop_token stop) { animate_ball(stop, fps); });
+
         [[maybe_unused]] auto _ = std::getchar();
+
+        _ball.request_stop();
+        _ball.join();
+
+        if (auto computed = _frame_memo.computed())
+        {
+            millicast::Logger::log("Metadata computed for " + std::to_string(computed) + " frames, reused for "
+                + std::to_string(_frame_memo.reused()) + " other layers", millicast::LogLevel::MC_LOG);
+        }
+        if (auto overruns = _samples.overruns())
+        {
+            millicast::Logger::log("Metadata samples dropped : " + std::to_string(overruns), millicast::LogLevel::MC_LOG);
+        }
+        if (auto dropped = _imu_samples.overruns() + _imu_batch.dropped())
+        {
+            millicast::Logger::log("IMU samples dropped : " + std::to_string(dropped), millicast::LogLevel::MC_LOG);
+        }
+        if (_scheduler.budget())
+        {
+            log_budget_stats("critical", metadata::Priority::CRITICAL);
+            log_budget_stats("best effort", metadata::Priority::BEST_EFFORT);
+            millicast::Logger::log("Metadata IMU samples deferred : " + std::to_string(_imu_deferred.load())
+                + ", dropped : " + std::to_string(_imu_batch.dropped()), millicast::LogLevel::MC_LOG);
+        }
+        for (const auto& [name, provider] : _options.async_providers)
+        {
+            if (auto missed = provider->missed_deadlines())
+            {
+                millicast::Logger::log("Metadata provider " + name + " missed deadlines : " + std::to_string(missed), millicast::LogLevel::MC_LOG);
+            }
+        }
+        for (std::size_t i = 0; i < _options.providers.size(); ++i)
+        {
+            if (auto malformed = _options.providers[i]->malformed())
+            {
+                millicast::Logger::log("Metadata provider " + _options.provider_names[i] + " malformed inputs dropped : "
+                    + std::to_string(malformed), millicast::LogLevel::MC_LOG);
+            }
+        }
+    }
+
+    // Feeds a position from any thread (tracker, sensor reader, ...) without
+    // blocking. The next frame carries the latest one. When the frames do not
+    // keep up the oldest positions are dropped; returns false in that case.
+    bool push_position(int32_t x, int32_t y) noexcept
+    {
+        return _samples.push({ std::chrono::steady_clock::now(), x, y });
+    }
+
+    // Feeds an IMU sample from the sensor thread, at up to a few kHz. The
+    // samples received between two frames are sent together with the next one.
+    bool push_imu_sample(const std::array<float, 6>& values) noexcept
+    {
+        return _imu_samples.push({ std::chrono::steady_clock::now(), values });
+    }
+
+    // Sends a message too large for a single frame (masks, point sets, ...).
+    // It is split across the next frames, METADATA_FRAGMENT_BUDGET bytes at a
+    // time. Thread-safe. Returns false if too many bytes are already queued.
+    bool send_message(std::vector<uint8_t> message)
+    {
+        if (_options.legacy_layout) return false;
+        return _fragmenter.push(std::move(message));
+    }
+
+    // Switches the metadata encryption to a new key. Thread-safe. Viewers must
+    // know the key id before the first frame encrypted with it arrives.
+    void rotate_key(uint8_t id, std::span<const uint8_t> key)
+    {
+        _encryptor.add_key(id, key);
+        _encryptor.set_active_key(id);
     }
 
     /* Publisher::Listener overrides */
@@ -84,7 +559,29 @@ public:
         millicast::Logger::log(message, millicast::LogLevel::MC_ERROR);
     }
 
-    void on_stats_report(const millicast::StatsReport&) override {}
+    void on_stats_report(const millicast::StatsReport& report) override
+    {
+        if (!_options.redundancy_max_depth) return;
+
+        using millicast::rtcstats::RemoteInboundRtpStream;
+
+        double fraction_lost = 0;
+        double round_trip_time = 0;
+        for (const auto* stats : report.get_stats_of_type<RemoteInboundRtpStream>())
+        {
+            if (stats->kind != "video") continue;
+
+            fraction_lost = std::max(fraction_lost, stats->fraction_lost);
+            round_trip_time = std::max(round_trip_time, stats->round_trip_time);
+        }
+
+        const auto depth = _redundancy_controller.update(fraction_lost, round_trip_time);
+        if (depth != _redundancy_encoder.depth())
+        {
+            millicast::Logger::log("Metadata redundancy depth : " + std::to_string(depth), millicast::LogLevel::MC_LOG);
+            _redundancy_encoder.set_depth(depth);
+        }
+    }
 
     void on_viewer_count(int count) override 
     {
@@ -104,36 +601,397 @@ public:
     void on_active() override {}
     void on_inactive() override {}
 
-    void encode(int32_t value, std::vector<uint8_t>& data)
+    void on_transformable_frame(uint32_t ssrc, uint32_t timestamp, std::vector<uint8_t>& data) override
     {
-        data.push_back((value >> 24) & 0xff);
-        data.push_back((value >> 16) & 0xff);
-        data.push_back((value >> 8) & 0xff);
-        data.push_back(value & 0xff);
+        const auto arrival = std::chrono::steady_clock::now();
+
+        _frame_memo.get(timestamp, [&](FrameMetadata& frame) { compute_frame(frame, timestamp, arrival); },
+            [&](const FrameMetadata& frame)
+            {
+                if (frame.unchanged)
+                {
+                    data.push_back(metadata::UNCHANGED_MARKER);
+                    return;
+                }
+
+                const auto payload_offset = data.size();
+                data.reserve(payload_offset + frame_size(frame));
+                data.insert(data.end(), frame.position.begin(), frame.position.end());
+
+                if (_options.legacy_layout) return;
+
+                close_block(ssrc, timestamp, data, payload_offset, frame.position_flags);
+
+                if (!frame.sensors.empty())
+                {
+                    const auto sensor_offset = data.size();
+                    data.insert(data.end(), frame.sensors.begin(), frame.sensors.end());
+                    close_block(ssrc, timestamp, data, sensor_offset, frame.sensor_flags);
+                }
+
+                auto block = frame.providers.begin();
+                for (const auto& [size, flags] : frame.provider_blocks)
+                {
+                    const auto block_offset = data.size();
+                    data.insert(data.end(), block, block + static_cast<std::ptrdiff_t>(size));
+                    close_block(ssrc, timestamp, data, block_offset, flags);
+                    block += static_cast<std::ptrdiff_t>(size);
+                }
+
+                if (!frame.fragments.empty())
+                {
+                    const auto fragment_offset = data.size();
+                    data.insert(data.end(), frame.fragments.begin(), frame.fragments.end());
+                    close_block(ssrc, timestamp, data, fragment_offset, frame.fragment_flags);
+                }
+            });
     }
 
-    void on_transformable_frame([[maybe_unused]] uint32_t ssrc, [[maybe_unused]] uint32_t timestamp, std::vector<uint8_t>& data) override
+private:
+
+    // Stands for a real tracker: moves the logo at the capture frame rate on
+    // its own thread and pushes the positions like any producer would.
+    void animate_ball(std::stop_token stop, int fps)
     {
         constexpr uint8_t SPEED = 10;
+        const auto period = std::chrono::microseconds{ 1'000'000 / std::max(fps, 1) };
+
+        int32_t x = width / 2, y = height / 2;
+        int8_t dir_x = 1, dir_y = 1;
+        auto next = std::chrono::steady_clock::now();
+
+        while (!stop.stop_requested())
+        {
+            if (x == width || x == 0)
+            {
+                dir_x *= -1;
+            }
+
+            if (y == height || y == 0)
+            {
+                dir_y *= -1;
+            }
+
+            x += dir_x * SPEED;
+            y += dir_y * SPEED;
+
+            x = std::clamp(x, 0, width);
+            y = std::clamp(y, 0, height);
+
+            push_position(x, y);
+
+            next += period;
+            std::this_thread::sleep_until(next);
+        }
+    }
+
+    // Takes the position at the capture time of the frame and serializes the
+    // blocks of a new timestamp, once for all the simulcast layers. Runs
+    // under the memo lock. The position is encoded last, once the other
+    // blocks told whether the frame has anything new.
+    void compute_frame(FrameMetadata& frame, uint32_t timestamp, std::chrono::steady_clock::time_point arrival)
+    {
+        const auto capture_time = _rtp_clock.capture_time(timestamp, arrival);
+
+        _samples.drain([this](const PositionSample& sample) { _history.push(sample); });
+        sample_position(capture_time);
+
+        frame.unchanged = false;
+        frame.position.clear();
+        frame.sensors.clear();
+        frame.providers.clear();
+        frame.provider_blocks.clear();
+        frame.fragments.clear();
+
+        if (_options.legacy_layout)
+        {
+            frame.position_flags = encode_position(frame.position);
+            return;
+        }
 
-        if (pos_x == width || pos_x == 0)
+        const bool blocks_changed = write_blocks(frame, capture_time);
+        if (_deadband && unchanged(blocks_changed, capture_time))
         {
-            dir_x *= -1;
+            frame.unchanged = true;
+            return;
         }
 
-        if (pos_y == height || pos_y == 0)
+        if (_options.redundancy_max_depth && _redundancy_encoder.depth())
         {
-            dir_y *= -1;
+            _sample.clear();
+            frame.position_flags = static_cast<uint8_t>(encode_position(_sample) | metadata::flags::REDUNDANT);
+            _redundancy_encoder.encode(_sample, frame.position);
         }
+        else
+        {
+            _redundancy_encoder.restart();
+            frame.position_flags = encode_position(frame.position);
+        }
+
+        metadata::append_schema_tag(frame.position, position_schema_tag());
+        frame.position_flags = static_cast<uint8_t>(frame.position_flags | metadata::flags::SCHEMA);
+        frame.position_flags = compress(frame.position, frame.position_flags);
 
-        pos_x += dir_x * SPEED;
-        pos_y += dir_y * SPEED;
+        schedule_blocks(frame, capture_time);
+    }
+
+    // Serializes the provider blocks and collects the sensor samples. Returns
+    // true when one of the blocks after the position has news: sensor
+    // samples, pending fragments or a provider block that differs from the
+    // one it last sent.
+    bool write_blocks(FrameMetadata& frame, std::chrono::steady_clock::time_point capture_time)
+    {
+        _imu_samples.drain([this](const ImuSample& sample) { _imu_batch.add(sample); });
+
+        bool providers_changed = false;
+        _frame_providers.clear();
+        frame.providers.reserve(_max_provider_size);
+        for (std::size_t i = 0; i < _options.providers.size(); ++i)
+        {
+            const auto& provider = _options.providers[i];
+            if (!provider->sample(capture_time)) continue;
+
+            _block.resize(provider->max_size());
+            _block.resize(std::min(provider->serialize(_block), _block.size()));
+
+            // Payloads are compared without the schema tag, so the stale bit
+            // of a repeated value is not a change.
+            if (_deadband)
+            {
+                providers_changed = providers_changed || provider->changed(_provider_sent[i], _block);
+                _provider_payloads[i].assign(_block.begin(), _block.end());
+            }
+
+            metadata::append_schema_tag(_block, provider->schema());
+            const auto flags = compress(_block, metadata::flags::SCHEMA);
+
+            frame.providers.insert(frame.providers.end(), _block.begin(), _block.end());
+            frame.provider_blocks.emplace_back(_block.size(), flags);
+            _frame_providers.push_back({ .provider = i, .request = 0 });
+        }
+
+        return providers_changed || !_imu_batch.empty() || _fragmenter.next_size();
+    }
+
+    // Shares METADATA_FRAME_BUDGET between the blocks, the position and the
+    // critical providers first. Writes the sensor and fragment blocks that
+    // fit; the samples and fragments of the others wait for the next frames.
+    // The IMU batch is cut to what is left of the budget when it does not
+    // fit whole, its oldest samples first, so it cannot grow out of reach.
+    // Deferred provider blocks are dropped, as the provider sends a fresh
+    // value with a later frame.
+    void schedule_blocks(FrameMetadata& frame, std::chrono::steady_clock::time_point capture_time)
+    {
+        constexpr std::size_t NONE = SIZE_MAX;
 
-        pos_x = std::clamp(pos_x, 0, width);
-        pos_y = std::clamp(pos_y, 0, height);
+        _scheduler.begin();
+        _scheduler.request(_position_source, block_cost(frame.position.size()));
 
-        encode(pos_x, data);
-        encode(pos_y, data);
+        const auto sensor_header_cost = block_cost(metadata::SENSOR_BATCH_HEADER_SIZE + metadata::SCHEMA_TAG_SIZE);
+        const auto sensors = _imu_batch.empty() ? NONE
+            : _scheduler.request(_sensor_source, block_cost(_imu_batch.block_size() + metadata::SCHEMA_TAG_SIZE),
+                sensor_header_cost + _imu_batch.sample_size);
+
+        for (std::size_t i = 0; i < _frame_providers.size(); ++i)
+        {
+            auto& block = _frame_providers[i];
+            block.request = _scheduler.request(_provider_sources[block.provider], block_cost(frame.provider_blocks[i].first));
+        }
+
+        const auto fragment_size = _fragmenter.next_size();
+        const auto fragments = fragment_size ? _scheduler.request(_fragment_source, block_cost(fragment_size)) : NONE;
+
+        _scheduler.schedule();
+
+        if (sensors != NONE && _scheduler.granted(sensors))
+        {
+            _imu_batch.write(capture_time, frame.sensors, (_scheduler.granted_size(sensors) - sensor_header_cost) / _imu_batch.sample_size);
+            metadata::append_schema_tag(frame.sensors, { metadata::schemas::SENSOR_BATCH, metadata::SENSOR_BATCH_SCHEMA_VERSION });
+            frame.sensor_flags = compress(frame.sensors, metadata::flags::SCHEMA);
+        }
+        _imu_deferred.fetch_add(_imu_batch.size(), std::memory_order_relaxed);
+
+        // Keeps the granted provider blocks, in place.
+        std::size_t kept = 0;
+        auto in = frame.providers.begin();
+        auto out = frame.providers.begin();
+        for (std::size_t i = 0; i < _frame_providers.size(); ++i)
+        {
+            const auto size = static_cast<std::ptrdiff_t>(frame.provider_blocks[i].first);
+            const auto& block = _frame_providers[i];
+            if (_scheduler.granted(block.request))
+            {
+                if (_deadband) std::swap(_provider_sent[block.provider], _provider_payloads[block.provider]);
+
+                out = out == in ? out + size : std::copy(in, in + size, out);
+                frame.provider_blocks[kept++] = frame.provider_blocks[i];
+            }
+            in += size;
+        }
+        frame.providers.erase(out, frame.providers.end());
+        frame.provider_blocks.resize(kept);
+
+        if (fragments != NONE && _scheduler.granted(fragments) && _fragmenter.write(frame.fragments))
+        {
+            frame.fragment_flags = compress(frame.fragments, metadata::flags::FRAGMENT);
+        }
+    }
+
+    // Bytes a block with payload_size bytes takes once closed.
+    std::size_t block_cost(std::size_t payload_size) const noexcept
+    {
+        return payload_size + metadata::FOOTER_SIZE + (_options.crc ? metadata::CRC_SIZE : 0)
+            + (_options.key_id ? metadata::ENCRYPTION_OVERHEAD : 0);
+    }
+
+    void log_budget_stats(const std::string& name, metadata::Priority priority)
+    {
+        const auto stats = _scheduler.stats(priority);
+        millicast::Logger::log("Metadata " + name + " blocks sent : " + std::to_string(stats.sent) + " (" + std::to_string(stats.sent_bytes)
+            + " bytes), deferred : " + std::to_string(stats.deferred) + " (" + std::to_string(stats.deferred_bytes) + " bytes)",
+            millicast::LogLevel::MC_LOG);
+    }
+
+    // With change_only, whether the frame only needs UNCHANGED_MARKER.
+    // Otherwise the position is recorded as sent, and on keep-alive the DELTA
+    // and STATE_SYNC encoders send the full values for the viewers that just
+    // joined.
+    bool unchanged(bool blocks_changed, std::chrono::steady_clock::time_point now)
+    {
+        const std::array values{ pos_x, pos_y };
+
+        if (_deadband->keepalive_due(now))
+        {
+            _delta_encoder.force_keyframe();
+            _state_sync_encoder.force_snapshot();
+        }
+        else if (!blocks_changed && !_deadband->changed(std::span<const int32_t>(values)))
+        {
+            return true;
+        }
+
+        _deadband->sent(std::span<const int32_t>(values), now);
+        return false;
+    }
+
+    // Called once the capture format is known, sizes the provider buffers.
+    void prepare_providers(const metadata::ProviderContext& context)
+    {
+        std::size_t largest = 0;
+        for (const auto& provider : _options.providers)
+        {
+            provider->prepare(context);
+            largest = std::max(largest, provider->max_size());
+            _max_provider_size += provider->max_size() + metadata::SCHEMA_TAG_SIZE;
+        }
+        _provider_sent.resize(_options.providers.size());
+        _provider_payloads.resize(_options.providers.size());
+
+        _block.reserve(largest + metadata::SCHEMA_TAG_SIZE);
+        _compressed.reserve(largest + metadata::SCHEMA_TAG_SIZE);
+    }
+
+    // Bytes the blocks of frame take once closed, at most.
+    static std::size_t frame_size(const FrameMetadata& frame) noexcept
+    {
+        constexpr auto BLOCK_OVERHEAD = metadata::ENCRYPTION_OVERHEAD + metadata::CRC_SIZE + metadata::FOOTER_SIZE;
+        const auto blocks = 3 + frame.provider_blocks.size();
+
+        return frame.position.size() + frame.sensors.size() + frame.providers.size() + frame.fragments.size()
+            + blocks * BLOCK_OVERHEAD;
+    }
+
+    // Sets pos_x/pos_y to the position at capture_time. Holds the newest
+    // sample when the frame is more recent than all of them.
+    void sample_position(std::chrono::steady_clock::time_point capture_time)
+    {
+        const auto bracket = _history.find(capture_time);
+        if (!bracket) return;
+
+        if (!_options.interpolate)
+        {
+            pos_x = bracket->before->pos_x;
+            pos_y = bracket->before->pos_y;
+            return;
+        }
+
+        const auto lerp = [fraction = bracket->fraction](int32_t from, int32_t to)
+        {
+            return static_cast<int32_t>(std::lround(from + (static_cast<double>(to) - from) * fraction));
+        };
+
+        pos_x = lerp(bracket->before->pos_x, bracket->after->pos_x);
+        pos_y = lerp(bracket->before->pos_y, bracket->after->pos_y);
+    }
+
+    // Compresses payload if that makes it smaller, returns the updated flags.
+    uint8_t compress(std::vector<uint8_t>& payload, uint8_t flags)
+    {
+        if (!_compressor || payload.size() < MIN_COMPRESSED_SIZE) return flags;
+
+        _compressed.clear();
+        if (!_compressor->compress(payload, _compressed)) return flags;
+
+        payload.swap(_compressed);
+        return static_cast<uint8_t>(flags | metadata::flags::COMPRESSED);
+    }
+
+    // Encrypts the block started at payload_offset when a key is active, then
+    // appends its footer. Differs for each layer as the nonce has the ssrc.
+    void close_block(uint32_t ssrc, uint32_t timestamp, std::vector<uint8_t>& data, std::size_t payload_offset, uint8_t flags)
+    {
+        if (_encryptor.seal(ssrc, timestamp, data, payload_offset))
+        {
+            flags = static_cast<uint8_t>(flags | metadata::flags::ENCRYPTED);
+        }
+
+        if (_options.crc)
+        {
+            flags = static_cast<uint8_t>(flags | metadata::flags::CRC32C);
+        }
+
+        metadata::append_footer(data, payload_offset, flags);
+    }
+
+    // Writes the current position with the configured encoding and returns
+    // the matching footer flags.
+    uint8_t encode_position(std::vector<uint8_t>& data)
+    {
+        uint8_t flags = metadata::flags::NONE;
+
+        switch (_options.encoding)
+        {
+        case MetadataEncoding::FIXED:
+            metadata::PositionSchema::write({ pos_x, pos_y }, data);
+            break;
+        case MetadataEncoding::DELTA:
+            _delta_encoder.encode(std::array{ pos_x, pos_y }, data);
+            flags = metadata::flags::DELTA;
+            break;
+        case MetadataEncoding::STATE_SYNC:
+            _state_sync_encoder.encode(std::array{ pos_x, pos_y }, data);
+            flags = metadata::flags::STATE_SYNC;
+            break;
+        case MetadataEncoding::NORMALIZED:
+            _quantized_encoder.encode(std::array{ metadata::NormalizedPoint{
+                .x = width ? static_cast<float>(pos_x) / static_cast<float>(width) : 0.0f,
+                .y = height ? static_cast<float>(pos_y) / static_cast<float>(height) : 0.0f,
+                .kind = 0,
+                .flags = 0,
+            } }, data);
+            break;
+        }
+
+        return flags;
+    }
+
+    metadata::SchemaTag position_schema_tag() const noexcept
+    {
+        if (_options.encoding == MetadataEncoding::NORMALIZED)
+        {
+            return { metadata::schemas::NORMALIZED_POSITION, metadata::QUANTIZED_SCHEMA_VERSION };
+        }
+        return { metadata::schemas::POSITION, metadata::POSITION_SCHEMA_VERSION };
     }
 
 };
@@ -166,7 +1024,7 @@ int main()
   millicast::Logger::set_logger([](const std::string& msg, millicast::LogLevel lvl) -> void { print_logs(msg, lvl); });
 
   {
-      MetadataPublisher publisher;
+      MetadataPublisher publisher(get_metadata_options());
       publisher.run();
   }
 
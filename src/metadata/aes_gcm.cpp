@@ -0,0 +1,654 @@
+#include "aes_gcm.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include "byte_order.h"
+#include "cpu_features.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define METADATA_AES_X64
+#include <immintrin.h>
+#endif
+
+#if defined(METADATA_AES_X64) && !defined(_MSC_VER)
+#define METADATA_AES_TARGET __attribute__((target("aes,pclmul,ssse3,sse4.1")))
+#define METADATA_AES_LAMBDA_TARGET __attribute__((target("aes,pclmul,ssse3,sse4.1")))
+#define METADATA_VAES_TARGET __attribute__((target("aes,pclmul,ssse3,sse4.1,avx2,vaes,vpclmulqdq")))
+#else
+#define METADATA_AES_TARGET
+#define METADATA_AES_LAMBDA_TARGET
+#define METADATA_VAES_TARGET
+#endif
+
+namespace metadata
+{
+
+namespace
+{
+
+// Portable AES ///////////////////////////////////////////////////////////////
+
+constexpr uint8_t SBOX[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+constexpr uint8_t xtime(uint8_t x) noexcept
+{
+    return static_cast<uint8_t>((x << 1) ^ ((x >> 7) * 0x1b));
+}
+
+void expand_key(std::span<const uint8_t> key, int rounds, uint8_t* round_keys) noexcept
+{
+    const auto nk = key.size() / 4;
+    const auto words = static_cast<std::size_t>(4 * (rounds + 1));
+    uint8_t rcon = 1;
+
+    std::memcpy(round_keys, key.data(), key.size());
+
+    for (auto i = nk; i < words; ++i)
+    {
+        uint8_t temp[4];
+        std::memcpy(temp, round_keys + 4 * (i - 1), 4);
+
+        if (i % nk == 0)
+        {
+            const uint8_t first = temp[0];
+            temp[0] = static_cast<uint8_t>(SBOX[temp[1]] ^ rcon);
+            temp[1] = SBOX[temp[2]];
+            temp[2] = SBOX[temp[3]];
+            temp[3] = SBOX[first];
+            rcon = xtime(rcon);
+        }
+        else if (nk > 6 && i % nk == 4)
+        {
+            for (auto& byte : temp) byte = SBOX[byte];
+        }
+
+        for (std::size_t k = 0; k < 4; ++k)
+        {
+            round_keys[4 * i + k] = static_cast<uint8_t>(round_keys[4 * (i - nk) + k] ^ temp[k]);
+        }
+    }
+}
+
+void encrypt_block(const uint8_t* round_keys, int rounds, const uint8_t* in, uint8_t* out) noexcept
+{
+    uint8_t state[16];
+    for (int i = 0; i < 16; ++i) state[i] = static_cast<uint8_t>(in[i] ^ round_keys[i]);
+
+    for (int round = 1; round <= rounds; ++round)
+    {
+        // SubBytes + ShiftRows, the state is column major: state[4 * column + row]
+        uint8_t shifted[16];
+        for (int column = 0; column < 4; ++column)
+        {
+            for (int row = 0; row < 4; ++row)
+            {
+                shifted[4 * column + row] = SBOX[state[4 * ((column + row) % 4) + row]];
+            }
+        }
+
+        if (round != rounds)
+        {
+            for (int column = 0; column < 4; ++column)
+            {
+                auto* a = shifted + 4 * column;
+                const uint8_t a0 = a[0], a1 = a[1], a2 = a[2], a3 = a[3];
+                const auto t = static_cast<uint8_t>(a0 ^ a1 ^ a2 ^ a3);
+                a[0] = static_cast<uint8_t>(a0 ^ t ^ xtime(static_cast<uint8_t>(a0 ^ a1)));
+                a[1] = static_cast<uint8_t>(a1 ^ t ^ xtime(static_cast<uint8_t>(a1 ^ a2)));
+                a[2] = static_cast<uint8_t>(a2 ^ t ^ xtime(static_cast<uint8_t>(a2 ^ a3)));
+                a[3] = static_cast<uint8_t>(a3 ^ t ^ xtime(static_cast<uint8_t>(a3 ^ a0)));
+            }
+        }
+
+        const auto* round_key = round_keys + 16 * round;
+        for (int i = 0; i < 16; ++i) state[i] = static_cast<uint8_t>(shifted[i] ^ round_key[i]);
+    }
+
+    std::memcpy(out, state, 16);
+}
+
+// Portable GHASH /////////////////////////////////////////////////////////////
+
+struct Block
+{
+    uint64_t hi;
+    uint64_t lo;
+};
+
+Block load_block(const uint8_t* in) noexcept
+{
+    return { load_be<uint64_t>(in), load_be<uint64_t>(in + 8) };
+}
+
+// Multiplication in GF(2^128), bit by bit as in SP 800-38D algorithm 1.
+Block gf_multiply(Block x, Block h) noexcept
+{
+    Block z{ 0, 0 };
+    Block v = h;
+
+    for (int i = 0; i < 128; ++i)
+    {
+        const uint64_t bit = i < 64 ? (x.hi >> (63 - i)) & 1 : (x.lo >> (127 - i)) & 1;
+        const uint64_t mask = 0 - bit;
+        z.hi ^= v.hi & mask;
+        z.lo ^= v.lo & mask;
+
+        const uint64_t carry = 0 - (v.lo & 1);
+        v.lo = (v.lo >> 1) | (v.hi << 63);
+        v.hi = (v.hi >> 1) ^ (0xe100000000000000ull & carry);
+    }
+
+    return z;
+}
+
+void ghash_portable(Block& y, const uint8_t* h, std::span<const uint8_t> data) noexcept
+{
+    const Block hb = load_block(h);
+
+    while (!data.empty())
+    {
+        uint8_t padded[16] = {};
+        const auto n = std::min<std::size_t>(16, data.size());
+        std::memcpy(padded, data.data(), n);
+        data = data.subspan(n);
+
+        const Block x = load_block(padded);
+        y = gf_multiply({ y.hi ^ x.hi, y.lo ^ x.lo }, hb);
+    }
+}
+
+void ctr_portable(const uint8_t* round_keys, int rounds, const AesGcm::Nonce& nonce, std::span<uint8_t> data) noexcept
+{
+    uint8_t counter[16];
+    std::memcpy(counter, nonce.data(), nonce.size());
+
+    for (uint32_t block = 2; !data.empty(); ++block)
+    {
+        store_be(counter + 12, block);
+
+        uint8_t keystream[16];
+        encrypt_block(round_keys, rounds, counter, keystream);
+
+        const auto n = std::min<std::size_t>(16, data.size());
+        for (std::size_t i = 0; i < n; ++i) data[i] ^= keystream[i];
+        data = data.subspan(n);
+    }
+}
+
+#ifdef METADATA_AES_X64
+
+// AES-NI / PCLMULQDQ ////////////////////////////////////////////////////////
+//
+// GHASH runs on byte-reflected blocks, following Intel's "Carry-Less
+// Multiplication and Its Usage for Computing the GCM Mode" white paper. Eight
+// blocks are encrypted in parallel to hide the aesenc latency, then multiplied
+// by H^8..H^1 and reduced once. With VAES and VPCLMULQDQ, chunks of sixteen
+// blocks go two per 256-bit register first and are multiplied by H^16..H^1.
+
+METADATA_AES_TARGET inline __m128i byte_reverse(__m128i x) noexcept
+{
+    return _mm_shuffle_epi8(x, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+METADATA_AES_TARGET inline void clmul_accumulate(__m128i a, __m128i b, __m128i& lo, __m128i& hi) noexcept
+{
+    const __m128i t0 = _mm_clmulepi64_si128(a, b, 0x00);
+    const __m128i t1 = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01));
+    const __m128i t2 = _mm_clmulepi64_si128(a, b, 0x11);
+
+    lo = _mm_xor_si128(lo, _mm_xor_si128(t0, _mm_slli_si128(t1, 8)));
+    hi = _mm_xor_si128(hi, _mm_xor_si128(t2, _mm_srli_si128(t1, 8)));
+}
+
+METADATA_AES_TARGET inline __m128i clmul_reduce(__m128i lo, __m128i hi) noexcept
+{
+    // Shift the 256-bit product left by one bit (reflected operands).
+    __m128i carry_lo = _mm_srli_epi32(lo, 31);
+    __m128i carry_hi = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+
+    const __m128i cross = _mm_srli_si128(carry_lo, 12);
+    carry_hi = _mm_slli_si128(carry_hi, 4);
+    carry_lo = _mm_slli_si128(carry_lo, 4);
+    lo = _mm_or_si128(lo, carry_lo);
+    hi = _mm_or_si128(_mm_or_si128(hi, carry_hi), cross);
+
+    // Reduce modulo x^128 + x^7 + x^2 + x + 1.
+    __m128i a = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)), _mm_slli_epi32(lo, 25));
+    const __m128i b = _mm_srli_si128(a, 4);
+    a = _mm_slli_si128(a, 12);
+    lo = _mm_xor_si128(lo, a);
+
+    __m128i c = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)), _mm_srli_epi32(lo, 7));
+    c = _mm_xor_si128(c, b);
+    lo = _mm_xor_si128(lo, c);
+
+    return _mm_xor_si128(hi, lo);
+}
+
+METADATA_AES_TARGET inline __m128i gf_multiply_hw(__m128i a, __m128i b) noexcept
+{
+    __m128i lo = _mm_setzero_si128();
+    __m128i hi = _mm_setzero_si128();
+    clmul_accumulate(a, b, lo, hi);
+    return clmul_reduce(lo, hi);
+}
+
+struct RoundKeys
+{
+    __m128i keys[15];
+    int rounds;
+};
+
+METADATA_AES_TARGET inline RoundKeys load_round_keys(const uint8_t* round_keys, int rounds) noexcept
+{
+    RoundKeys rk;
+    rk.rounds = rounds;
+    for (int i = 0; i <= rounds; ++i)
+    {
+        rk.keys[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(round_keys + 16 * i));
+    }
+    return rk;
+}
+
+METADATA_AES_TARGET inline __m128i aes_encrypt_hw(__m128i block, const RoundKeys& rk) noexcept
+{
+    block = _mm_xor_si128(block, rk.keys[0]);
+    for (int i = 1; i < rk.rounds; ++i) block = _mm_aesenc_si128(block, rk.keys[i]);
+    return _mm_aesenclast_si128(block, rk.keys[rk.rounds]);
+}
+
+constexpr int PARALLEL_BLOCKS = 8;
+
+// The per-block loops are unrolled through index sequences so the blocks stay
+// in registers whatever the optimisation level.
+template<int Rounds, std::size_t... B>
+METADATA_AES_TARGET inline void aes_encrypt8_hw(__m128i* blocks, const RoundKeys& rk, std::index_sequence<B...>) noexcept
+{
+    ((blocks[B] = _mm_xor_si128(blocks[B], rk.keys[0])), ...);
+    for (int i = 1; i < Rounds; ++i)
+    {
+        const __m128i key = rk.keys[i];
+        ((blocks[B] = _mm_aesenc_si128(blocks[B], key)), ...);
+    }
+    ((blocks[B] = _mm_aesenclast_si128(blocks[B], rk.keys[Rounds])), ...);
+}
+
+struct HashKeys
+{
+    __m128i powers[PARALLEL_BLOCKS];    // powers[i] = H^(i+1)
+    __m128i karatsuba[PARALLEL_BLOCKS]; // hi ^ lo halves of powers[i]
+};
+
+// y = (y ^ x[0]) * H^8 ^ x[1] * H^7 ^ ... ^ x[7] * H, with Karatsuba
+// multiplications (3 carry-less products per block) and a single reduction.
+template<std::size_t... B>
+METADATA_AES_TARGET inline __m128i ghash8_hw(__m128i y, const __m128i* x, const HashKeys& keys, std::index_sequence<B...>) noexcept
+{
+    __m128i lo = _mm_setzero_si128();
+    __m128i hi = _mm_setzero_si128();
+    __m128i mid = _mm_setzero_si128();
+
+    auto accumulate = [&](__m128i block, std::size_t power) METADATA_AES_LAMBDA_TARGET
+    {
+        const __m128i h = keys.powers[power];
+        lo = _mm_xor_si128(lo, _mm_clmulepi64_si128(block, h, 0x00));
+        hi = _mm_xor_si128(hi, _mm_clmulepi64_si128(block, h, 0x11));
+        const __m128i folded = _mm_xor_si128(block, _mm_shuffle_epi32(block, 0x4e));
+        mid = _mm_xor_si128(mid, _mm_clmulepi64_si128(folded, keys.karatsuba[power], 0x00));
+    };
+
+    (accumulate(B == 0 ? _mm_xor_si128(x[B], y) : x[B], PARALLEL_BLOCKS - 1 - B), ...);
+
+    mid = _mm_xor_si128(mid, _mm_xor_si128(lo, hi));
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+    return clmul_reduce(lo, hi);
+}
+
+METADATA_AES_TARGET inline __m128i load_partial(std::span<const uint8_t> data) noexcept
+{
+    alignas(16) uint8_t padded[16] = {};
+    std::memcpy(padded, data.data(), std::min<std::size_t>(16, data.size()));
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(padded));
+}
+
+// Nonce followed by the big-endian 32-bit block counter.
+METADATA_AES_TARGET inline __m128i counter_block(__m128i base, uint32_t counter) noexcept
+{
+    return _mm_insert_epi32(base, static_cast<int>(byteswap(counter)), 3);
+}
+
+METADATA_AES_TARGET __m128i ghash_hw(__m128i y, __m128i h, std::span<const uint8_t> data) noexcept
+{
+    while (!data.empty())
+    {
+        y = gf_multiply_hw(_mm_xor_si128(y, byte_reverse(load_partial(data))), h);
+        data = data.subspan(std::min<std::size_t>(16, data.size()));
+    }
+    return y;
+}
+
+constexpr int WIDE_BLOCKS = 16;
+constexpr int WIDE_REGISTERS = WIDE_BLOCKS / 2;
+
+METADATA_AES_TARGET void compute_h_powers(const uint8_t* h, uint8_t* powers) noexcept
+{
+    const __m128i h1 = byte_reverse(_mm_loadu_si128(reinterpret_cast<const __m128i*>(h)));
+
+    __m128i power = h1;
+    for (int i = 0; i < WIDE_BLOCKS; ++i)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(powers + 16 * i), power);
+        power = gf_multiply_hw(power, h1);
+    }
+}
+
+// VAES / VPCLMULQDQ ////////////////////////////////////////////////////////
+//
+// Register i holds blocks 2i and 2i+1 of a chunk, one per 128-bit lane.
+
+struct WideHashKeys
+{
+    __m256i powers[WIDE_REGISTERS];    // H^(16-2i) and H^(15-2i)
+    __m256i karatsuba[WIDE_REGISTERS];
+};
+
+METADATA_VAES_TARGET inline __m256i byte_reverse_wide(__m256i x) noexcept
+{
+    const __m128i mask = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    return _mm256_shuffle_epi8(x, _mm256_broadcastsi128_si256(mask));
+}
+
+METADATA_VAES_TARGET inline void clmul_accumulate_wide(__m256i block, __m256i h, __m256i karatsuba,
+    __m256i& lo, __m256i& hi, __m256i& mid) noexcept
+{
+    lo = _mm256_xor_si256(lo, _mm256_clmulepi64_epi128(block, h, 0x00));
+    hi = _mm256_xor_si256(hi, _mm256_clmulepi64_epi128(block, h, 0x11));
+    const __m256i folded = _mm256_xor_si256(block, _mm256_shuffle_epi32(block, 0x4e));
+    mid = _mm256_xor_si256(mid, _mm256_clmulepi64_epi128(folded, karatsuba, 0x00));
+}
+
+METADATA_VAES_TARGET inline __m128i fold_lanes(__m256i x) noexcept
+{
+    return _mm_xor_si128(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+}
+
+// Same as ghash8_hw over sixteen blocks, the lanes are added before the
+// single reduction.
+template<std::size_t... B>
+METADATA_VAES_TARGET inline __m128i ghash16_wide(__m128i y, const __m256i* x, const WideHashKeys& keys, std::index_sequence<B...>) noexcept
+{
+    __m256i lo = _mm256_setzero_si256();
+    __m256i hi = _mm256_setzero_si256();
+    __m256i mid = _mm256_setzero_si256();
+
+    (clmul_accumulate_wide(B == 0 ? _mm256_xor_si256(x[B], _mm256_zextsi128_si256(y)) : x[B],
+        keys.powers[B], keys.karatsuba[B], lo, hi, mid), ...);
+
+    __m128i lo128 = fold_lanes(lo);
+    __m128i hi128 = fold_lanes(hi);
+    const __m128i mid128 = _mm_xor_si128(fold_lanes(mid), _mm_xor_si128(lo128, hi128));
+    lo128 = _mm_xor_si128(lo128, _mm_slli_si128(mid128, 8));
+    hi128 = _mm_xor_si128(hi128, _mm_srli_si128(mid128, 8));
+    return clmul_reduce(lo128, hi128);
+}
+
+template<int Rounds, std::size_t... B>
+METADATA_VAES_TARGET inline void aes_encrypt16_wide(__m256i* blocks, const __m256i* keys, std::index_sequence<B...>) noexcept
+{
+    ((blocks[B] = _mm256_xor_si256(blocks[B], keys[0])), ...);
+    for (int i = 1; i < Rounds; ++i)
+    {
+        const __m256i key = keys[i];
+        ((blocks[B] = _mm256_aesenc_epi128(blocks[B], key)), ...);
+    }
+    ((blocks[B] = _mm256_aesenclast_epi128(blocks[B], keys[Rounds])), ...);
+}
+
+// Encrypts the whole chunks of data, advancing p, remaining, counter and y.
+// The GHASH of a chunk overlaps the AES of the next one like in crypt_hw.
+template<int Rounds>
+METADATA_VAES_TARGET void crypt_wide(const uint8_t* round_keys, const uint8_t* h_powers, __m128i base,
+    uint8_t*& p, std::size_t& remaining, uint32_t& counter, __m128i& y, bool encrypt) noexcept
+{
+    constexpr std::size_t CHUNK = 16 * WIDE_BLOCKS;
+    if (remaining < CHUNK) return;
+
+    __m256i keys[Rounds + 1];
+    for (int i = 0; i <= Rounds; ++i)
+    {
+        keys[i] = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(round_keys + 16 * i)));
+    }
+
+    WideHashKeys hash_keys;
+    for (int i = 0; i < WIDE_REGISTERS; ++i)
+    {
+        const __m128i even = _mm_loadu_si128(reinterpret_cast<const __m128i*>(h_powers + 16 * (WIDE_BLOCKS - 1 - 2 * i)));
+        const __m128i odd = _mm_loadu_si128(reinterpret_cast<const __m128i*>(h_powers + 16 * (WIDE_BLOCKS - 2 - 2 * i)));
+        hash_keys.powers[i] = _mm256_inserti128_si256(_mm256_castsi128_si256(even), odd, 1);
+        hash_keys.karatsuba[i] = _mm256_xor_si256(hash_keys.powers[i], _mm256_shuffle_epi32(hash_keys.powers[i], 0x4e));
+    }
+
+    // Counters are incremented on the byte-reversed blocks, where the
+    // big-endian 32-bit counter becomes the first little-endian lane.
+    __m256i reversed = _mm256_add_epi32(_mm256_broadcastsi128_si256(byte_reverse(counter_block(base, counter))),
+        _mm256_set_epi32(0, 0, 0, 1, 0, 0, 0, 0));
+    const __m256i step = _mm256_set_epi32(0, 0, 0, 2, 0, 0, 0, 2);
+
+    constexpr auto registers_sequence = std::make_index_sequence<WIDE_REGISTERS>{};
+    __m256i pending[WIDE_REGISTERS];
+    bool has_pending = false;
+
+    for (; remaining >= CHUNK; p += CHUNK, remaining -= CHUNK, counter += WIDE_BLOCKS)
+    {
+        __m256i blocks[WIDE_REGISTERS];
+        for (int b = 0; b < WIDE_REGISTERS; ++b)
+        {
+            blocks[b] = byte_reverse_wide(reversed);
+            reversed = _mm256_add_epi32(reversed, step);
+        }
+        aes_encrypt16_wide<Rounds>(blocks, keys, registers_sequence);
+
+        if (has_pending) y = ghash16_wide(y, pending, hash_keys, registers_sequence);
+
+        for (int b = 0; b < WIDE_REGISTERS; ++b)
+        {
+            const __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32 * b));
+            const __m256i out = _mm256_xor_si256(in, blocks[b]);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(p + 32 * b), out);
+            pending[b] = byte_reverse_wide(encrypt ? out : in);
+        }
+        has_pending = true;
+    }
+
+    y = ghash16_wide(y, pending, hash_keys, registers_sequence);
+    _mm256_zeroupper();
+}
+
+template<int Rounds>
+METADATA_AES_TARGET AesGcm::Tag crypt_hw(const uint8_t* round_keys, const uint8_t* h_powers,
+    const AesGcm::Nonce& nonce, std::span<const uint8_t> aad, std::span<uint8_t> data, bool encrypt, bool wide) noexcept
+{
+    const RoundKeys rk = load_round_keys(round_keys, Rounds);
+
+    HashKeys keys;
+    for (int i = 0; i < PARALLEL_BLOCKS; ++i)
+    {
+        keys.powers[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(h_powers + 16 * i));
+        keys.karatsuba[i] = _mm_xor_si128(keys.powers[i], _mm_shuffle_epi32(keys.powers[i], 0x4e));
+    }
+    const __m128i h1 = keys.powers[0];
+
+    alignas(16) uint8_t j0_bytes[16] = {};
+    std::memcpy(j0_bytes, nonce.data(), nonce.size());
+    const __m128i base = _mm_load_si128(reinterpret_cast<const __m128i*>(j0_bytes));
+
+    __m128i y = ghash_hw(_mm_setzero_si128(), h1, aad);
+
+    uint8_t* p = data.data();
+    std::size_t remaining = data.size();
+    uint32_t counter = 2;
+
+    if (wide) crypt_wide<Rounds>(round_keys, h_powers, base, p, remaining, counter, y, encrypt);
+
+    // The GHASH of a chunk is computed while the next one is encrypted, so the
+    // aesenc and pclmulqdq units work in parallel.
+    constexpr std::size_t CHUNK = 16 * PARALLEL_BLOCKS;
+    constexpr auto blocks_sequence = std::make_index_sequence<PARALLEL_BLOCKS>{};
+    __m128i pending[PARALLEL_BLOCKS];
+    bool has_pending = false;
+
+    for (; remaining >= CHUNK; p += CHUNK, remaining -= CHUNK, counter += PARALLEL_BLOCKS)
+    {
+        __m128i blocks[PARALLEL_BLOCKS];
+        for (int b = 0; b < PARALLEL_BLOCKS; ++b)
+        {
+            blocks[b] = counter_block(base, counter + static_cast<uint32_t>(b));
+        }
+        aes_encrypt8_hw<Rounds>(blocks, rk, blocks_sequence);
+
+        if (has_pending) y = ghash8_hw(y, pending, keys, blocks_sequence);
+
+        for (int b = 0; b < PARALLEL_BLOCKS; ++b)
+        {
+            const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * b));
+            const __m128i out = _mm_xor_si128(in, blocks[b]);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(p + 16 * b), out);
+            pending[b] = byte_reverse(encrypt ? out : in);
+        }
+        has_pending = true;
+    }
+
+    if (has_pending) y = ghash8_hw(y, pending, keys, blocks_sequence);
+
+    for (; remaining > 0; ++counter)
+    {
+        const auto n = std::min<std::size_t>(16, remaining);
+        const __m128i keystream = aes_encrypt_hw(counter_block(base, counter), rk);
+        const __m128i in = load_partial({ p, n });
+        const __m128i out = _mm_xor_si128(in, keystream);
+
+        alignas(16) uint8_t bytes[16];
+        _mm_store_si128(reinterpret_cast<__m128i*>(bytes), out);
+        std::memcpy(p, bytes, n);
+
+        // GHASH works on the zero padded ciphertext
+        const __m128i cipher = encrypt ? load_partial({ bytes, n }) : in;
+        y = gf_multiply_hw(_mm_xor_si128(y, byte_reverse(cipher)), h1);
+
+        p += n;
+        remaining -= n;
+    }
+
+    const __m128i lengths = _mm_set_epi64x(static_cast<long long>(aad.size() * 8), static_cast<long long>(data.size() * 8));
+    y = gf_multiply_hw(_mm_xor_si128(y, lengths), h1);
+
+    const __m128i tag = _mm_xor_si128(byte_reverse(y), aes_encrypt_hw(counter_block(base, 1), rk));
+
+    AesGcm::Tag out;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out.data()), tag);
+    return out;
+}
+
+#endif
+
+} // anonymous namespace
+
+AesGcm::AesGcm(std::span<const uint8_t> key)
+    : _rounds{ key.size() == 32 ? 14 : 10 }, _hardware{ hardware_available() },
+      _wide{ _hardware && cpu_features().vaes && cpu_features().vpclmulqdq }
+{
+    if (key.size() != 16 && key.size() != 32)
+    {
+        throw std::invalid_argument("AES-GCM keys must be 16 or 32 bytes long.");
+    }
+
+    expand_key(key, _rounds, _round_keys.data());
+
+    const uint8_t zero[16] = {};
+    encrypt_block(_round_keys.data(), _rounds, zero, _h.data());
+
+#ifdef METADATA_AES_X64
+    if (_hardware) compute_h_powers(_h.data(), _h_powers.data());
+#endif
+}
+
+bool AesGcm::hardware_available() noexcept
+{
+    const auto& cpu = cpu_features();
+    return cpu.aes && cpu.pclmul && cpu.ssse3 && cpu.sse41;
+}
+
+AesGcm::Tag AesGcm::crypt(const Nonce& nonce, std::span<const uint8_t> aad, std::span<uint8_t> data, bool encrypt) const noexcept
+{
+#ifdef METADATA_AES_X64
+    if (_hardware)
+    {
+        return _rounds == 10
+            ? crypt_hw<10>(_round_keys.data(), _h_powers.data(), nonce, aad, data, encrypt, _wide)
+            : crypt_hw<14>(_round_keys.data(), _h_powers.data(), nonce, aad, data, encrypt, _wide);
+    }
+#endif
+
+    Block y{ 0, 0 };
+    ghash_portable(y, _h.data(), aad);
+
+    if (encrypt) ctr_portable(_round_keys.data(), _rounds, nonce, data);
+    ghash_portable(y, _h.data(), data);
+    if (!encrypt) ctr_portable(_round_keys.data(), _rounds, nonce, data);
+
+    uint8_t lengths[16];
+    store_be<uint64_t>(lengths, aad.size() * 8);
+    store_be<uint64_t>(lengths + 8, data.size() * 8);
+    ghash_portable(y, _h.data(), lengths);
+
+    uint8_t j0[16] = {};
+    std::memcpy(j0, nonce.data(), nonce.size());
+    j0[15] = 1;
+
+    uint8_t mask[16];
+    encrypt_block(_round_keys.data(), _rounds, j0, mask);
+
+    Tag tag;
+    store_be(tag.data(), y.hi);
+    store_be(tag.data() + 8, y.lo);
+    for (std::size_t i = 0; i < tag.size(); ++i) tag[i] ^= mask[i];
+    return tag;
+}
+
+AesGcm::Tag AesGcm::seal(const Nonce& nonce, std::span<const uint8_t> aad, std::span<uint8_t> data) const noexcept
+{
+    return crypt(nonce, aad, data, true);
+}
+
+bool AesGcm::open(const Nonce& nonce, std::span<const uint8_t> aad, std::span<uint8_t> data, const Tag& tag) const noexcept
+{
+    const auto expected = crypt(nonce, aad, data, false);
+
+    uint8_t diff = 0;
+    for (std::size_t i = 0; i < tag.size(); ++i) diff |= static_cast<uint8_t>(expected[i] ^ tag[i]);
+    return diff == 0;
+}
+
+} // metadata
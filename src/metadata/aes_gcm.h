@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace metadata
+{
+
+// AES-GCM (NIST SP 800-38D) with 96-bit nonces and 128-bit tags, for 128 or
+// 256-bit keys. Uses AES-NI and PCLMULQDQ when the CPU supports them, with
+// their 256-bit VAES and VPCLMULQDQ forms when available, and a portable
+// implementation otherwise. The portable path is not constant time
+// and is only meant as a fallback.
+class AesGcm
+{
+public:
+
+    static constexpr std::size_t NONCE_SIZE = 12;
+    static constexpr std::size_t TAG_SIZE = 16;
+
+    using Nonce = std::array<uint8_t, NONCE_SIZE>;
+    using Tag = std::array<uint8_t, TAG_SIZE>;
+
+    // key must be 16 or 32 bytes, throws std::invalid_argument otherwise.
+    explicit AesGcm(std::span<const uint8_t> key);
+
+    // Encrypts data in place and returns the authentication tag of aad + data.
+    Tag seal(const Nonce& nonce, std::span<const uint8_t> aad, std::span<uint8_t> data) const noexcept;
+
+    // Decrypts data in place. Returns false, leaving data undefined, when the
+    // tag does not match.
+    bool open(const Nonce& nonce, std::span<const uint8_t> aad, std::span<uint8_t> data, const Tag& tag) const noexcept;
+
+    static bool hardware_available() noexcept;
+
+private:
+
+    alignas(16) std::array<uint8_t, 16 * 15> _round_keys{};
+    alignas(16) std::array<uint8_t, 16 * 16> _h_powers{}; // H..H^16, byte-reflected for the hardware path
+    std::array<uint8_t, 16> _h{};
+    int _rounds;
+    bool _hardware;
+    bool _wide; // VAES and VPCLMULQDQ
+
+    Tag crypt(const Nonce& nonce, std::span<const uint8_t> aad, std::span<uint8_t> data, bool encrypt) const noexcept;
+};
+
+} // metadata
@@ -0,0 +1,90 @@
+#include "async_provider.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace metadata
+{
+
+AsyncProvider::AsyncProvider(std::shared_ptr<MetadataProvider> provider, std::chrono::microseconds deadline) :
+    _provider{ std::move(provider) },
+    _deadline{ deadline },
+    _thread{ [this](std::stop_token stop) { run(stop); } }
+{
+}
+
+bool AsyncProvider::sample(clock::time_point capture_time)
+{
+    const auto now = clock::now();
+
+    // Frame period, to request the next capture time ahead.
+    const auto period = _last_capture && capture_time > *_last_capture ? capture_time - *_last_capture : clock::duration{};
+    _last_capture = capture_time;
+
+    bool fresh = false;
+    {
+        std::lock_guard lock(_mutex);
+        if (_result_new)
+        {
+            _result_new = false;
+            std::swap(_last, _result);
+            fresh = !_last.late;
+        }
+        else if (_busy && !_busy_missed && now > _busy_deadline)
+        {
+            _busy_missed = true;
+            _missed.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        _request = capture_time + period;
+        _request_deadline = now + _deadline;
+    }
+    _wake.notify_one();
+
+    _stale = !fresh;
+    return _last.valid;
+}
+
+std::size_t AsyncProvider::serialize(std::span<uint8_t> out)
+{
+    const auto size = std::min(_last.payload.size(), out.size());
+    std::memcpy(out.data(), _last.payload.data(), size);
+    return size;
+}
+
+void AsyncProvider::run(std::stop_token stop)
+{
+    std::unique_lock lock(_mutex);
+    while (_wake.wait(lock, stop, [this] { return _request.has_value(); }))
+    {
+        const auto capture_time = *_request;
+        const auto deadline = _request_deadline;
+        _request.reset();
+        _busy = true;
+        _busy_deadline = deadline;
+        _busy_missed = false;
+        lock.unlock();
+
+        _work.valid = _provider->sample(capture_time);
+        _work.payload.resize(_work.valid ? _provider->max_size() : 0);
+        if (_work.valid)
+        {
+            _work.payload.resize(std::min(_provider->serialize(_work.payload), _work.payload.size()));
+        }
+        _work.tag = _provider->schema();
+        const auto done = clock::now();
+
+        lock.lock();
+        _busy = false;
+        _work.late = done > deadline;
+        if (_work.late && !_busy_missed)
+        {
+            _missed.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        std::swap(_result, _work);
+        _result_new = true;
+    }
+}
+
+} // metadata
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "provider.h"
+
+namespace metadata
+{
+
+// Runs a provider on its own thread so a slow computation never holds the
+// frame transformer. Each frame hands the thread a request for the predicted
+// capture time of the next frame, one frame period ahead, and takes the
+// result of the previous request without waiting:
+//
+//   - done within deadline of its request: sent as is
+//   - late, or still running: the last value is sent again with the stale
+//     bit of its schema tag (versioning.h), and the missed deadline counted
+//
+// A provider that keeps up thus sends values sampled at the capture time of
+// the frame carrying them. When the thread is still busy, newer requests
+// replace the pending one. The wrapped provider is only called from the
+// thread, after prepare.
+class AsyncProvider : public MetadataProvider
+{
+    using clock = std::chrono::steady_clock;
+
+    struct Result
+    {
+        std::vector<uint8_t> payload;
+        SchemaTag tag{};
+        bool valid{ false }; // the provider had something to send
+        bool late{ false };
+    };
+
+    std::shared_ptr<MetadataProvider> _provider;
+    clock::duration _deadline;
+
+    std::mutex _mutex;
+    std::condition_variable_any _wake;
+    std::optional<clock::time_point> _request; // capture time to sample, latest wins
+    clock::time_point _request_deadline{};
+    bool _busy{ false };
+    clock::time_point _busy_deadline{};
+    bool _busy_missed{ false }; // missed deadline already counted
+    Result _result; // of the last request done
+    bool _result_new{ false };
+
+    Result _last; // sent with the frames, only used by the frame thread
+    bool _stale{ false };
+    std::optional<clock::time_point> _last_capture;
+
+    Result _work; // only used by the thread
+    std::atomic<uint64_t> _missed{ 0 };
+    std::jthread _thread; // last, stops before the members it uses go away
+
+public:
+
+    AsyncProvider(std::shared_ptr<MetadataProvider> provider, std::chrono::microseconds deadline);
+
+    SchemaTag schema() const noexcept override { return { _last.tag.id, _last.tag.version, _stale }; }
+
+    std::size_t max_size() const noexcept override { return _provider->max_size(); }
+
+    // Called before the first sample, when the thread has nothing to do yet.
+    void prepare(const ProviderContext& context) override { _provider->prepare(context); }
+
+    bool sample(clock::time_point capture_time) override;
+
+    std::size_t serialize(std::span<uint8_t> out) override;
+
+    // Compares values, a stale repeat is not a change. Called from the frame
+    // thread while the wrapped provider may be sampling: overrides must only
+    // read their configuration.
+    bool changed(std::span<const uint8_t> sent, std::span<const uint8_t> payload) const override
+    {
+        return _provider->changed(sent, payload);
+    }
+
+    uint64_t malformed() const noexcept override { return _provider->malformed(); }
+
+    // Requests not done within the deadline. Thread-safe.
+    uint64_t missed_deadlines() const noexcept { return _missed.load(std::memory_order_relaxed); }
+
+private:
+
+    void run(std::stop_token stop);
+};
+
+} // metadata
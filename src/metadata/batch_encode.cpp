@@ -0,0 +1,169 @@
+#include "batch_encode.h"
+
+#include <bit>
+#include <cstring>
+
+#include "byte_order.h"
+#include "cpu_features.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define METADATA_BATCH_X64
+#include <immintrin.h>
+#endif
+
+#if defined(METADATA_BATCH_X64) && !defined(_MSC_VER)
+#define METADATA_SSSE3_TARGET __attribute__((target("ssse3")))
+#define METADATA_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define METADATA_SSSE3_TARGET
+#define METADATA_AVX2_TARGET
+#endif
+
+namespace metadata
+{
+
+namespace
+{
+
+// Byte-swaps count elements of Size bytes from in to out. Byte swapping is its
+// own inverse, so the same routines serve both directions.
+using SwapCopy = void (*)(const uint8_t* in, uint8_t* out, std::size_t count) noexcept;
+
+template<typename U>
+void swap_copy_scalar(const uint8_t* in, uint8_t* out, std::size_t count) noexcept
+{
+    for (std::size_t i = 0; i < count; ++i, in += sizeof(U), out += sizeof(U))
+    {
+        U value;
+        std::memcpy(&value, in, sizeof(U));
+        value = byteswap(value);
+        std::memcpy(out, &value, sizeof(U));
+    }
+}
+
+#ifdef METADATA_BATCH_X64
+
+template<std::size_t Size>
+METADATA_SSSE3_TARGET inline __m128i shuffle_mask128() noexcept
+{
+    if constexpr (Size == 4) return _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    else return _mm_set_epi8(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1);
+}
+
+template<typename U>
+METADATA_SSSE3_TARGET void swap_copy_ssse3(const uint8_t* in, uint8_t* out, std::size_t count) noexcept
+{
+    constexpr std::size_t PER_VECTOR = 16 / sizeof(U);
+    const __m128i mask = shuffle_mask128<sizeof(U)>();
+
+    std::size_t i = 0;
+    for (; i + 2 * PER_VECTOR <= count; i += 2 * PER_VECTOR)
+    {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * sizeof(U)));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * sizeof(U) + 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * sizeof(U)), _mm_shuffle_epi8(a, mask));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * sizeof(U) + 16), _mm_shuffle_epi8(b, mask));
+    }
+    for (; i + PER_VECTOR <= count; i += PER_VECTOR)
+    {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * sizeof(U)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * sizeof(U)), _mm_shuffle_epi8(a, mask));
+    }
+
+    swap_copy_scalar<U>(in + i * sizeof(U), out + i * sizeof(U), count - i);
+}
+
+template<typename U>
+METADATA_AVX2_TARGET void swap_copy_avx2(const uint8_t* in, uint8_t* out, std::size_t count) noexcept
+{
+    constexpr std::size_t PER_VECTOR = 32 / sizeof(U);
+
+    // vpshufb works within each 128-bit lane, so the mask is repeated.
+    const __m128i half = sizeof(U) == 4
+        ? _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3)
+        : _mm_set_epi8(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1);
+    const __m256i mask = _mm256_broadcastsi128_si256(half);
+
+    std::size_t i = 0;
+    for (; i + 2 * PER_VECTOR <= count; i += 2 * PER_VECTOR)
+    {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i * sizeof(U)));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i * sizeof(U) + 32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * sizeof(U)), _mm256_shuffle_epi8(a, mask));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * sizeof(U) + 32), _mm256_shuffle_epi8(b, mask));
+    }
+    for (; i + PER_VECTOR <= count; i += PER_VECTOR)
+    {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i * sizeof(U)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * sizeof(U)), _mm256_shuffle_epi8(a, mask));
+    }
+
+    swap_copy_scalar<U>(in + i * sizeof(U), out + i * sizeof(U), count - i);
+}
+
+#endif
+
+struct Implementation
+{
+    const char* name;
+    SwapCopy swap32;
+    SwapCopy swap16;
+};
+
+const Implementation& implementation() noexcept
+{
+    static const Implementation selected = []() -> Implementation
+    {
+        if constexpr (std::endian::native == std::endian::big)
+        {
+            return { "native", nullptr, nullptr };
+        }
+#ifdef METADATA_BATCH_X64
+        const auto& cpu = cpu_features();
+        if (cpu.avx2) return { "avx2", swap_copy_avx2<uint32_t>, swap_copy_avx2<uint16_t> };
+        if (cpu.ssse3) return { "ssse3", swap_copy_ssse3<uint32_t>, swap_copy_ssse3<uint16_t> };
+#endif
+        return { "scalar", swap_copy_scalar<uint32_t>, swap_copy_scalar<uint16_t> };
+    }();
+    return selected;
+}
+
+template<typename T>
+void swap_copy(const void* in, void* out, std::size_t count) noexcept
+{
+    const auto& impl = implementation();
+    auto* src = static_cast<const uint8_t*>(in);
+    auto* dst = static_cast<uint8_t*>(out);
+
+    if (!impl.swap32)
+    {
+        std::memcpy(dst, src, count * sizeof(T));
+    }
+    else if constexpr (sizeof(T) == 4)
+    {
+        impl.swap32(src, dst, count);
+    }
+    else
+    {
+        impl.swap16(src, dst, count);
+    }
+}
+
+} // anonymous namespace
+
+void store_be_array(std::span<const int32_t> values, uint8_t* out) noexcept { swap_copy<int32_t>(values.data(), out, values.size()); }
+void store_be_array(std::span<const uint32_t> values, uint8_t* out) noexcept { swap_copy<uint32_t>(values.data(), out, values.size()); }
+void store_be_array(std::span<const uint16_t> values, uint8_t* out) noexcept { swap_copy<uint16_t>(values.data(), out, values.size()); }
+void store_be_array(std::span<const float> values, uint8_t* out) noexcept { swap_copy<float>(values.data(), out, values.size()); }
+
+void load_be_array(const uint8_t* in, std::span<int32_t> values) noexcept { swap_copy<int32_t>(in, values.data(), values.size()); }
+void load_be_array(const uint8_t* in, std::span<uint32_t> values) noexcept { swap_copy<uint32_t>(in, values.data(), values.size()); }
+void load_be_array(const uint8_t* in, std::span<uint16_t> values) noexcept { swap_copy<uint16_t>(in, values.data(), values.size()); }
+void load_be_array(const uint8_t* in, std::span<float> values) noexcept { swap_copy<float>(in, values.data(), values.size()); }
+
+const char* batch_encode_implementation() noexcept
+{
+    return implementation().name;
+}
+
+} // metadata
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "byte_order.h"
+
+namespace metadata
+{
+
+// Big-endian conversion of whole arrays, for payloads carrying hundreds of
+// keypoints. Uses AVX2 or SSSE3 byte shuffles when the CPU supports them and a
+// scalar loop otherwise; the implementation is picked once at startup.
+// out must have room for values.size() * sizeof(T) bytes.
+
+void store_be_array(std::span<const int32_t> values, uint8_t* out) noexcept;
+void store_be_array(std::span<const uint32_t> values, uint8_t* out) noexcept;
+void store_be_array(std::span<const uint16_t> values, uint8_t* out) noexcept;
+void store_be_array(std::span<const float> values, uint8_t* out) noexcept;
+
+// Reverse operation, in reads values.size() * sizeof(T) bytes.
+void load_be_array(const uint8_t* in, std::span<int32_t> values) noexcept;
+void load_be_array(const uint8_t* in, std::span<uint32_t> values) noexcept;
+void load_be_array(const uint8_t* in, std::span<uint16_t> values) noexcept;
+void load_be_array(const uint8_t* in, std::span<float> values) noexcept;
+
+// Name of the implementation in use: "avx2", "ssse3" or "scalar".
+const char* batch_encode_implementation() noexcept;
+
+// Array of big-endian values read in place.
+template<typename T>
+class BigEndianArray
+{
+    const uint8_t* _data;
+    std::size_t _size;
+
+public:
+
+    BigEndianArray(const uint8_t* data, std::size_t size) noexcept : _data{ data }, _size{ size } {}
+
+    std::size_t size() const noexcept { return _size; }
+
+    T operator[](std::size_t index) const noexcept { return load_be<T>(_data + index * sizeof(T)); }
+
+    // Converts the whole array at once, out must hold size() values.
+    void copy_to(std::span<T> out) const noexcept { load_be_array(_data, out.first(_size)); }
+};
+
+// Appends values to data with a single resize.
+template<typename T>
+void append_be_array(std::span<const T> values, std::vector<uint8_t>& data)
+{
+    const auto offset = data.size();
+    data.resize(offset + values.size_bytes());
+    store_be_array(values, data.data() + offset);
+}
+
+} // metadata
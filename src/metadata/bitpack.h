@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+namespace metadata
+{
+
+// Bit-level packing of values narrower than a byte, most significant bit
+// first. Values are at most 32 bits wide.
+
+constexpr uint64_t bit_mask(unsigned bits) noexcept
+{
+    return (uint64_t{ 1 } << bits) - 1;
+}
+
+constexpr std::size_t packed_size(std::size_t bits) noexcept
+{
+    return (bits + 7) / 8;
+}
+
+class BitWriter
+{
+    uint8_t* _out;
+    uint64_t _pending{ 0 };
+    unsigned _pending_bits{ 0 };
+
+public:
+
+    explicit BitWriter(uint8_t* out) noexcept : _out{ out } {}
+
+    void write(uint32_t value, unsigned bits) noexcept
+    {
+        _pending = (_pending << bits) | (value & bit_mask(bits));
+        _pending_bits += bits;
+
+        while (_pending_bits >= 8)
+        {
+            _pending_bits -= 8;
+            *_out++ = static_cast<uint8_t>(_pending >> _pending_bits);
+        }
+    }
+
+    // Writes the last partial byte, padded with zeros. Returns the end of the
+    // written data.
+    uint8_t* flush() noexcept
+    {
+        if (_pending_bits)
+        {
+            *_out++ = static_cast<uint8_t>(_pending << (8 - _pending_bits));
+            _pending_bits = 0;
+        }
+        return _out;
+    }
+};
+
+class BitReader
+{
+    std::span<const uint8_t> _data;
+    std::size_t _pos{ 0 };
+    uint64_t _pending{ 0 };
+    unsigned _pending_bits{ 0 };
+
+public:
+
+    explicit BitReader(std::span<const uint8_t> data) noexcept : _data{ data } {}
+
+    // Returns nullopt past the end of data.
+    std::optional<uint32_t> read(unsigned bits) noexcept
+    {
+        while (_pending_bits < bits)
+        {
+            if (_pos == _data.size()) return std::nullopt;
+            _pending = (_pending << 8) | _data[_pos++];
+            _pending_bits += 8;
+        }
+
+        _pending_bits -= bits;
+        return static_cast<uint32_t>((_pending >> _pending_bits) & bit_mask(bits));
+    }
+};
+
+} // metadata
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace metadata
+{
+
+// Shares a per-frame byte budget between the blocks competing for a frame,
+// so the metadata adds a predictable overhead to the video bitrate.
+//
+// CRITICAL blocks are always sent, even over budget. BEST_EFFORT blocks fill
+// what is left: the sources deferred for the most frames first, and sources
+// of the same age in turn from a start that rotates every frame, so they
+// share the budget round-robin. A block that does not fit is deferred, its
+// source ages, and smaller blocks behind it may still fit. Blocks that can be
+// cut, like a batch of samples, get what is left of the budget instead when
+// the whole does not fit, so a growing batch cannot be deferred forever.
+//
+// Each frame: begin(), request() a size for every block, schedule(), then
+// granted() for each request.
+
+enum class Priority : uint8_t
+{
+    CRITICAL,
+    BEST_EFFORT,
+};
+
+constexpr std::size_t PRIORITY_COUNT = 2;
+
+struct BudgetStats
+{
+    uint64_t sent; // blocks
+    uint64_t deferred;
+    uint64_t sent_bytes;
+    uint64_t deferred_bytes;
+};
+
+class BudgetScheduler
+{
+    struct Source
+    {
+        Priority priority;
+        uint32_t age; // frames since a block of it was last sent
+    };
+
+    struct Request
+    {
+        std::size_t source;
+        std::size_t size;
+        std::size_t min_size; // size when the block cannot be cut
+        std::size_t granted_size;
+        bool granted;
+    };
+
+    // Written under the frame lock, read from any thread.
+    struct Counters
+    {
+        std::atomic<uint64_t> sent{ 0 };
+        std::atomic<uint64_t> deferred{ 0 };
+        std::atomic<uint64_t> sent_bytes{ 0 };
+        std::atomic<uint64_t> deferred_bytes{ 0 };
+    };
+
+    std::size_t _budget;
+    std::vector<Source> _sources;
+    std::vector<Request> _requests;
+    std::vector<std::size_t> _order; // best-effort requests, in scheduling order
+    std::size_t _rotation{ 0 };
+    std::array<Counters, PRIORITY_COUNT> _counters;
+
+public:
+
+    // budget: bytes per frame, 0 for no limit.
+    explicit BudgetScheduler(std::size_t budget) noexcept : _budget{ budget } {}
+
+    std::size_t budget() const noexcept { return _budget; }
+
+    // Returns the id of the new source.
+    std::size_t add_source(Priority priority)
+    {
+        _sources.push_back({ priority, 0 });
+        return _sources.size() - 1;
+    }
+
+    void begin() noexcept { _requests.clear(); }
+
+    // A block of size bytes from source in this frame. Returns the request id.
+    std::size_t request(std::size_t source, std::size_t size) { return request(source, size, size); }
+
+    // A block of size bytes that can be cut down to min_size bytes when the
+    // whole does not fit. Returns the request id.
+    std::size_t request(std::size_t source, std::size_t size, std::size_t min_size)
+    {
+        _requests.push_back({ source, size, std::min(min_size, size), 0, false });
+        return _requests.size() - 1;
+    }
+
+    void schedule()
+    {
+        std::size_t used = 0;
+        _order.clear();
+        for (std::size_t i = 0; i < _requests.size(); ++i)
+        {
+            auto& request = _requests[i];
+            if (_budget && _sources[request.source].priority != Priority::CRITICAL)
+            {
+                _order.push_back(i);
+                continue;
+            }
+            request.granted = true;
+            request.granted_size = request.size;
+            used += request.size;
+        }
+
+        const auto rotation = _rotation++;
+        const auto turn = [&](std::size_t request)
+        {
+            return (_requests[request].source + _sources.size() - rotation % _sources.size()) % _sources.size();
+        };
+        std::sort(_order.begin(), _order.end(), [&](std::size_t a, std::size_t b)
+        {
+            const auto age_a = _sources[_requests[a].source].age;
+            const auto age_b = _sources[_requests[b].source].age;
+            return age_a != age_b ? age_a > age_b : turn(a) < turn(b);
+        });
+
+        for (const auto i : _order)
+        {
+            auto& request = _requests[i];
+            if (used + request.min_size > _budget) continue;
+
+            request.granted = true;
+            request.granted_size = std::min(request.size, _budget - used);
+            used += request.granted_size;
+        }
+
+        for (const auto& request : _requests)
+        {
+            auto& source = _sources[request.source];
+            auto& counters = _counters[static_cast<std::size_t>(source.priority)];
+            if (request.granted)
+            {
+                source.age = 0;
+                counters.sent.fetch_add(1, std::memory_order_relaxed);
+                counters.sent_bytes.fetch_add(request.granted_size, std::memory_order_relaxed);
+                counters.deferred_bytes.fetch_add(request.size - request.granted_size, std::memory_order_relaxed);
+            }
+            else
+            {
+                source.age++;
+                counters.deferred.fetch_add(1, std::memory_order_relaxed);
+                counters.deferred_bytes.fetch_add(request.size, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool granted(std::size_t request) const noexcept { return _requests[request].granted; }
+
+    // Bytes granted, less than the size requested when the block was cut.
+    std::size_t granted_size(std::size_t request) const noexcept { return _requests[request].granted_size; }
+
+    // Totals since the start. Thread-safe.
+    BudgetStats stats(Priority priority) const noexcept
+    {
+        const auto& counters = _counters[static_cast<std::size_t>(priority)];
+        return {
+            .sent = counters.sent.load(std::memory_order_relaxed),
+            .deferred = counters.deferred.load(std::memory_order_relaxed),
+            .sent_bytes = counters.sent_bytes.load(std::memory_order_relaxed),
+            .deferred_bytes = counters.deferred_bytes.load(std::memory_order_relaxed),
+        };
+    }
+};
+
+} // metadata
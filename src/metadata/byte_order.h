@@ -0,0 +1,95 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#ifdef _MSC_VER
+#include <stdlib.h>
+#endif
+
+namespace metadata
+{
+
+// Network (big-endian) byte order helpers used by every payload writer.
+// Values are stored with a single memcpy so the compiler emits one bswap + mov
+// per field instead of a shift/mask per byte.
+
+template<typename T>
+constexpr T byteswap(T value) noexcept
+{
+    static_assert(std::is_integral_v<T>, "byteswap requires an integral type");
+
+    using U = std::make_unsigned_t<T>;
+    auto u = static_cast<U>(value);
+
+    if constexpr (sizeof(T) == 1)
+    {
+        return value;
+    }
+    else if (std::is_constant_evaluated())
+    {
+        U out = 0;
+        for (std::size_t i = 0; i < sizeof(T); ++i)
+        {
+            out = static_cast<U>((out << 8) | ((u >> (i * 8)) & 0xff));
+        }
+        return static_cast<T>(out);
+    }
+#ifdef _MSC_VER
+    else if constexpr (sizeof(T) == 2) return static_cast<T>(_byteswap_ushort(u));
+    else if constexpr (sizeof(T) == 4) return static_cast<T>(_byteswap_ulong(u));
+    else return static_cast<T>(_byteswap_uint64(u));
+#else
+    else if constexpr (sizeof(T) == 2) return static_cast<T>(__builtin_bswap16(u));
+    else if constexpr (sizeof(T) == 4) return static_cast<T>(__builtin_bswap32(u));
+    else return static_cast<T>(__builtin_bswap64(u));
+#endif
+}
+
+// Unsigned integer carrying the bits of T on the wire. A specialization rather
+// than std::conditional_t so make_unsigned is never instantiated for floats.
+template<typename T, bool = std::is_floating_point_v<T>>
+struct wire_type
+{
+    using type = std::make_unsigned_t<T>;
+};
+
+template<typename T>
+struct wire_type<T, true>
+{
+    using type = std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>;
+};
+
+template<typename T>
+using wire_type_t = typename wire_type<T>::type;
+
+template<typename T>
+inline void store_be(uint8_t* out, T value) noexcept
+{
+    static_assert(std::is_arithmetic_v<T>, "store_be requires an arithmetic type");
+
+    auto bits = std::bit_cast<wire_type_t<T>>(value);
+    if constexpr (std::endian::native == std::endian::little)
+    {
+        bits = byteswap(bits);
+    }
+    std::memcpy(out, &bits, sizeof(bits));
+}
+
+template<typename T>
+inline T load_be(const uint8_t* in) noexcept
+{
+    static_assert(std::is_arithmetic_v<T>, "load_be requires an arithmetic type");
+
+    wire_type_t<T> bits;
+    std::memcpy(&bits, in, sizeof(bits));
+    if constexpr (std::endian::native == std::endian::little)
+    {
+        bits = byteswap(bits);
+    }
+    return std::bit_cast<T>(bits);
+}
+
+} // metadata
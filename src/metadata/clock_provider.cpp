@@ -0,0 +1,50 @@
+#include <chrono>
+
+#include "byte_order.h"
+#include "provider.h"
+
+namespace metadata
+{
+
+namespace
+{
+
+// Publisher wall clock at the capture of each frame, for viewers measuring
+// the glass to glass latency against their own synchronized clock:
+//
+//   [unix_time_us:i64]
+class ClockProvider : public MetadataProvider
+{
+    int64_t _unix_time_us{ 0 };
+
+public:
+
+    SchemaTag schema() const noexcept override { return { schemas::CLOCK, 1 }; }
+
+    std::size_t max_size() const noexcept override { return sizeof(int64_t); }
+
+    bool sample(std::chrono::steady_clock::time_point capture_time) override
+    {
+        using namespace std::chrono;
+
+        const auto age = steady_clock::now() - capture_time;
+        _unix_time_us = duration_cast<microseconds>((system_clock::now() - age).time_since_epoch()).count();
+        return true;
+    }
+
+    std::size_t serialize(std::span<uint8_t> out) override
+    {
+        store_be(out.data(), _unix_time_us);
+        return sizeof(int64_t);
+    }
+
+    // The clock moves on every frame: with METADATA_DEADBAND it only goes
+    // with the frames sent for other changes or the keep-alive.
+    bool changed(std::span<const uint8_t>, std::span<const uint8_t>) const override { return false; }
+};
+
+const ProviderRegistration registration("clock", [] { return std::make_unique<ClockProvider>(); });
+
+} // anonymous namespace
+
+} // metadata
@@ -0,0 +1,326 @@
+#include "compression.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <queue>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "byte_order.h"
+#include "varint.h"
+
+namespace metadata
+{
+
+namespace
+{
+
+constexpr uint32_t DICTIONARY_MAGIC = 0x4D434449; // "MCDI"
+
+constexpr int HASH_BITS = 12;
+constexpr uint32_t NO_POSITION = UINT32_MAX;
+constexpr std::size_t MIN_MATCH = 4;
+constexpr std::size_t MAX_OFFSET = 65535;
+
+uint32_t load32(const uint8_t* p) noexcept
+{
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+uint32_t hash4(uint32_t v) noexcept
+{
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+void write_length(std::vector<uint8_t>& out, std::size_t length)
+{
+    for (; length >= 255; length -= 255) out.push_back(255);
+    out.push_back(static_cast<uint8_t>(length));
+}
+
+void write_sequence(std::vector<uint8_t>& out, std::span<const uint8_t> literals, std::size_t offset, std::size_t match_length)
+{
+    const auto literal_nibble = std::min<std::size_t>(literals.size(), 15);
+    const auto match_nibble = match_length ? std::min<std::size_t>(match_length - MIN_MATCH, 15) : 0;
+    out.push_back(static_cast<uint8_t>(literal_nibble << 4 | match_nibble));
+
+    if (literal_nibble == 15) write_length(out, literals.size() - 15);
+    out.insert(out.end(), literals.begin(), literals.end());
+
+    if (!match_length) return;
+
+    out.push_back(static_cast<uint8_t>(offset & 0xff));
+    out.push_back(static_cast<uint8_t>(offset >> 8));
+    if (match_nibble == 15) write_length(out, match_length - MIN_MATCH - 15);
+}
+
+std::optional<std::size_t> read_length(std::span<const uint8_t> in, std::size_t& pos, std::size_t nibble)
+{
+    std::size_t length = nibble;
+    if (nibble != 15) return length;
+
+    while (pos < in.size())
+    {
+        const uint8_t byte = in[pos++];
+        length += byte;
+        if (byte != 255) return length;
+    }
+    return std::nullopt;
+}
+
+} // anonymous namespace
+
+Dictionary load_dictionary(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) throw std::runtime_error("Cannot open dictionary " + path);
+
+    std::vector<uint8_t> content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (content.size() < 8 || load_be<uint32_t>(content.data()) != DICTIONARY_MAGIC)
+    {
+        throw std::runtime_error("Invalid dictionary file " + path);
+    }
+
+    Dictionary dictionary{ load_be<uint32_t>(content.data() + 4), {} };
+    if (dictionary.id == 0) throw std::runtime_error("Dictionary id 0 is reserved: " + path);
+
+    dictionary.bytes.assign(content.begin() + 8, content.end());
+    return dictionary;
+}
+
+void save_dictionary(const std::string& path, const Dictionary& dictionary)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file) throw std::runtime_error("Cannot write dictionary " + path);
+
+    uint8_t header[8];
+    store_be(header, DICTIONARY_MAGIC);
+    store_be(header + 4, dictionary.id);
+
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(dictionary.bytes.data()), static_cast<std::streamsize>(dictionary.bytes.size()));
+    if (!file) throw std::runtime_error("Cannot write dictionary " + path);
+}
+
+std::vector<uint8_t> train_dictionary(const std::vector<std::vector<uint8_t>>& samples, std::size_t max_size)
+{
+    constexpr std::size_t K = 8;        // k-mer length used to score segments
+    constexpr std::size_t SEGMENT = 64; // bytes added to the dictionary at a time
+    constexpr std::size_t STRIDE = 16;
+
+    auto kmer = [](const uint8_t* p)
+    {
+        uint64_t v;
+        std::memcpy(&v, p, K);
+        return v;
+    };
+
+    // Number of samples each k-mer appears in.
+    std::unordered_map<uint64_t, uint32_t> frequency;
+    for (const auto& sample : samples)
+    {
+        std::unordered_set<uint64_t> seen;
+        for (std::size_t i = 0; i + K <= sample.size(); ++i) seen.insert(kmer(sample.data() + i));
+        for (auto k : seen) frequency[k]++;
+    }
+
+    struct Candidate
+    {
+        uint64_t score;
+        const uint8_t* data;
+        std::size_t size;
+        bool operator<(const Candidate& other) const { return score < other.score; }
+    };
+
+    // A k-mer seen in a single sample does not help compressing other ones.
+    auto score = [&](const uint8_t* data, std::size_t size)
+    {
+        uint64_t total = 0;
+        for (std::size_t i = 0; i + K <= size; ++i)
+        {
+            const auto it = frequency.find(kmer(data + i));
+            if (it != frequency.end() && it->second > 1) total += it->second;
+        }
+        return total;
+    };
+
+    std::priority_queue<Candidate> candidates;
+    for (const auto& sample : samples)
+    {
+        for (std::size_t i = 0; i < sample.size(); i += STRIDE)
+        {
+            const auto size = std::min(SEGMENT, sample.size() - i);
+            if (size < K) break;
+            candidates.push({ score(sample.data() + i, size), sample.data() + i, size });
+        }
+    }
+
+    // Greedy selection with lazy re-scoring: scores only decrease once the
+    // k-mers of a selected segment are marked as covered.
+    std::vector<uint8_t> dictionary;
+    while (!candidates.empty() && dictionary.size() < max_size)
+    {
+        auto best = candidates.top();
+        candidates.pop();
+
+        const auto current = score(best.data, best.size);
+        if (current == 0) continue;
+        if (current < best.score && !candidates.empty() && current < candidates.top().score)
+        {
+            best.score = current;
+            candidates.push(best);
+            continue;
+        }
+
+        const auto size = std::min(best.size, max_size - dictionary.size());
+        dictionary.insert(dictionary.end(), best.data, best.data + size);
+        for (std::size_t i = 0; i + K <= best.size; ++i) frequency.erase(kmer(best.data + i));
+    }
+
+    return dictionary;
+}
+
+Compressor::Compressor(std::shared_ptr<const Dictionary> dictionary)
+    : _dictionary_table(std::size_t{ 1 } << HASH_BITS, NO_POSITION)
+{
+    if (dictionary)
+    {
+        const auto& bytes = dictionary->bytes;
+        const auto size = std::min(bytes.size(), MAX_DICTIONARY_SIZE);
+
+        _dictionary_id = dictionary->id;
+        _dictionary_size = size;
+        _window.assign(bytes.end() - static_cast<std::ptrdiff_t>(size), bytes.end());
+
+        for (std::size_t i = 0; i + MIN_MATCH <= size; ++i)
+        {
+            _dictionary_table[hash4(load32(_window.data() + i))] = static_cast<uint32_t>(i);
+        }
+    }
+
+    _table = _dictionary_table;
+}
+
+bool Compressor::compress(std::span<const uint8_t> input, std::vector<uint8_t>& out)
+{
+    // Fresh history for every payload: each one must decode on its own.
+    _window.resize(_dictionary_size);
+    _window.insert(_window.end(), input.begin(), input.end());
+    std::copy(_dictionary_table.begin(), _dictionary_table.end(), _table.begin());
+
+    const auto start = out.size();
+    out.resize(start + 2 * MAX_VARINT_SIZE);
+    auto n = write_varint(out.data() + start, _dictionary_id);
+    n += write_varint(out.data() + start + n, input.size());
+    out.resize(start + n);
+
+    const uint8_t* window = _window.data();
+    const std::size_t end = _window.size();
+    std::size_t anchor = _dictionary_size;
+    std::size_t ip = _dictionary_size;
+
+    while (ip + MIN_MATCH <= end)
+    {
+        if (out.size() - start >= input.size())
+        {
+            out.resize(start);
+            return false;
+        }
+
+        const uint32_t value = load32(window + ip);
+        auto& slot = _table[hash4(value)];
+        const uint32_t candidate = slot;
+        slot = static_cast<uint32_t>(ip);
+
+        if (candidate == NO_POSITION || ip - candidate > MAX_OFFSET || load32(window + candidate) != value)
+        {
+            ip++;
+            continue;
+        }
+
+        std::size_t length = MIN_MATCH;
+        while (ip + length < end && window[candidate + length] == window[ip + length]) length++;
+
+        write_sequence(out, { window + anchor, ip - anchor }, ip - candidate, length);
+        ip += length;
+        anchor = ip;
+    }
+
+    write_sequence(out, { window + anchor, end - anchor }, 0, 0);
+
+    if (out.size() - start >= input.size())
+    {
+        out.resize(start);
+        return false;
+    }
+    return true;
+}
+
+void Decompressor::add_dictionary(std::shared_ptr<const Dictionary> dictionary)
+{
+    _dictionaries.push_back(std::move(dictionary));
+}
+
+std::optional<std::span<const uint8_t>> Decompressor::decompress(std::span<const uint8_t> payload, std::vector<uint8_t>& out) const
+{
+    std::size_t pos = 0;
+    const auto dictionary_id = read_varint(payload, pos);
+    const auto raw_size = read_varint(payload, pos);
+    if (!dictionary_id || !raw_size || *raw_size > _max_size) return std::nullopt;
+
+    std::span<const uint8_t> dictionary;
+    if (*dictionary_id != 0)
+    {
+        const auto it = std::find_if(_dictionaries.begin(), _dictionaries.end(),
+            [&](const auto& d) { return d->id == *dictionary_id; });
+        if (it == _dictionaries.end()) return std::nullopt;
+
+        dictionary = (*it)->bytes;
+        dictionary = dictionary.last(std::min(dictionary.size(), Compressor::MAX_DICTIONARY_SIZE));
+    }
+
+    const auto size = static_cast<std::size_t>(*raw_size);
+    out.resize(size);
+    std::size_t op = 0;
+
+    while (pos < payload.size())
+    {
+        const uint8_t token = payload[pos++];
+
+        const auto literals = read_length(payload, pos, token >> 4);
+        if (!literals || *literals > payload.size() - pos || *literals > size - op) return std::nullopt;
+
+        std::copy_n(payload.data() + pos, *literals, out.data() + op);
+        pos += *literals;
+        op += *literals;
+
+        if (pos == payload.size()) break;
+        if (payload.size() - pos < 2) return std::nullopt;
+
+        const std::size_t offset = payload[pos] | (payload[pos + 1] << 8);
+        pos += 2;
+
+        const auto match = read_length(payload, pos, token & 0x0f);
+        if (!match || offset == 0 || offset > op + dictionary.size()) return std::nullopt;
+
+        const auto length = *match + MIN_MATCH;
+        if (length > size - op) return std::nullopt;
+
+        // Byte by byte: the match may overlap the bytes it produces, or start
+        // in the dictionary.
+        for (std::size_t i = 0; i < length; ++i, ++op)
+        {
+            out[op] = op >= offset ? out[op - offset] : dictionary[dictionary.size() - (offset - op)];
+        }
+    }
+
+    if (op != size) return std::nullopt;
+    return std::span<const uint8_t>(out);
+}
+
+} // metadata
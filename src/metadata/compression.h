@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace metadata
+{
+
+// LZ77 block compression with an optional pre-trained dictionary, for
+// multi-kilobyte structured payloads. The dictionary acts as history that
+// precedes every payload, so even a small message finds long matches in it.
+//
+// A compressed block payload is:
+//
+//   [dictionary_id:varint][raw_size:varint][sequences]
+//
+// and the sequences follow the LZ4 block format: a token with literal and
+// match lengths, the literals, a 16-bit little-endian match offset.
+// dictionary_id 0 means no dictionary.
+
+struct Dictionary
+{
+    uint32_t id;
+    std::vector<uint8_t> bytes;
+};
+
+// Dictionary files are "MCDI", the big-endian id, then the bytes.
+// Both throw std::runtime_error on I/O or format errors.
+Dictionary load_dictionary(const std::string& path);
+void save_dictionary(const std::string& path, const Dictionary& dictionary);
+
+// Picks the segments that appear in the most samples until max_size bytes.
+std::vector<uint8_t> train_dictionary(const std::vector<std::vector<uint8_t>>& samples, std::size_t max_size);
+
+class Compressor
+{
+public:
+
+    static constexpr std::size_t MAX_DICTIONARY_SIZE = 65535;
+
+    // dictionary may be null. Larger dictionaries are truncated to their last
+    // MAX_DICTIONARY_SIZE bytes.
+    explicit Compressor(std::shared_ptr<const Dictionary> dictionary);
+
+    // Appends the compressed form of input to out. Returns false, leaving out
+    // untouched, when it would not be smaller than input.
+    bool compress(std::span<const uint8_t> input, std::vector<uint8_t>& out);
+
+private:
+
+    uint32_t _dictionary_id{ 0 };
+    std::size_t _dictionary_size{ 0 };
+    std::vector<uint8_t> _window;          // dictionary followed by the input
+    std::vector<uint32_t> _dictionary_table;
+    std::vector<uint32_t> _table;
+};
+
+class Decompressor
+{
+public:
+
+    explicit Decompressor(std::size_t max_size = 1 << 20) : _max_size{ max_size } {}
+
+    void add_dictionary(std::shared_ptr<const Dictionary> dictionary);
+
+    // Decompresses a COMPRESSED block payload into out, whose capacity is
+    // reused between calls. Returns nullopt for a malformed payload, an
+    // unknown dictionary or a raw size above max_size.
+    std::optional<std::span<const uint8_t>> decompress(std::span<const uint8_t> payload, std::vector<uint8_t>& out) const;
+
+private:
+
+    std::size_t _max_size;
+    std::vector<std::shared_ptr<const Dictionary>> _dictionaries;
+};
+
+} // metadata
@@ -0,0 +1,78 @@
+#include "cpu_features.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define METADATA_CPU_X64
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+#endif
+
+namespace metadata
+{
+
+namespace
+{
+
+#ifdef METADATA_CPU_X64
+#ifndef _MSC_VER
+__attribute__((target("xsave")))
+#endif
+unsigned long long read_xcr0() noexcept
+{
+    return _xgetbv(0);
+}
+#endif
+
+CpuFeatures detect() noexcept
+{
+    CpuFeatures features{};
+
+#ifdef METADATA_CPU_X64
+    unsigned ecx = 0;
+    unsigned ebx7 = 0;
+    unsigned ecx7 = 0;
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    ecx = static_cast<unsigned>(info[2]);
+    __cpuidex(info, 7, 0);
+    ebx7 = static_cast<unsigned>(info[1]);
+    ecx7 = static_cast<unsigned>(info[2]);
+#else
+    unsigned eax, ebx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return features;
+    unsigned edx7;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx7, &ecx7, &edx7)) ebx7 = ecx7 = 0;
+#endif
+
+    features.ssse3 = (ecx & (1u << 9)) != 0;
+    features.sse41 = (ecx & (1u << 19)) != 0;
+    features.sse42 = (ecx & (1u << 20)) != 0;
+    features.aes = (ecx & (1u << 25)) != 0;
+    features.pclmul = (ecx & (1u << 1)) != 0;
+
+    // AVX2 is usable only if the OS enabled the XMM and YMM state (OSXSAVE + XCR0).
+    const bool osxsave = (ecx & (1u << 27)) != 0;
+    if (osxsave && (read_xcr0() & 0x6) == 0x6)
+    {
+        features.avx2 = (ebx7 & (1u << 5)) != 0;
+        features.vaes = features.avx2 && (ecx7 & (1u << 9)) != 0;
+        features.vpclmulqdq = features.avx2 && (ecx7 & (1u << 10)) != 0;
+    }
+#endif
+
+    return features;
+}
+
+} // anonymous namespace
+
+const CpuFeatures& cpu_features() noexcept
+{
+    static const CpuFeatures features = detect();
+    return features;
+}
+
+} // metadata
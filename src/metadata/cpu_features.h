@@ -0,0 +1,22 @@
+#pragma once
+
+namespace metadata
+{
+
+// x86 instruction set extensions used by the accelerated code paths. All
+// false on other architectures.
+struct CpuFeatures
+{
+    bool ssse3;
+    bool sse41;
+    bool sse42;
+    bool aes;
+    bool pclmul;
+    bool avx2; // also requires the OS to save the YMM registers
+    bool vaes; // 256-bit AES and carry-less multiply, with avx2
+    bool vpclmulqdq;
+};
+
+const CpuFeatures& cpu_features() noexcept;
+
+} // metadata
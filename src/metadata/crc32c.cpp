@@ -0,0 +1,134 @@
+#include "crc32c.h"
+
+#include <array>
+#include <cstring>
+
+#include "byte_order.h"
+#include "cpu_features.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define METADATA_CRC32C_X64
+#include <nmmintrin.h>
+#endif
+
+namespace metadata
+{
+
+namespace
+{
+
+constexpr uint32_t POLYNOMIAL = 0x82f63b78; // reflected 0x1EDC6F41
+
+using Table = std::array<std::array<uint32_t, 256>, 8>;
+
+constexpr Table make_table()
+{
+    Table table{};
+
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            crc = (crc >> 1) ^ ((crc & 1) ? POLYNOMIAL : 0);
+        }
+        table[0][i] = crc;
+    }
+
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        for (std::size_t k = 1; k < 8; ++k)
+        {
+            table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xff];
+        }
+    }
+
+    return table;
+}
+
+constexpr Table TABLE = make_table();
+
+// Slicing-by-8 consumes 8 bytes per step with 8 table lookups.
+uint32_t crc32c_slicing8(const uint8_t* data, std::size_t size, uint32_t crc) noexcept
+{
+    for (; size >= 8; data += 8, size -= 8)
+    {
+        uint32_t lo, hi;
+        std::memcpy(&lo, data, 4);
+        std::memcpy(&hi, data + 4, 4);
+        if constexpr (std::endian::native == std::endian::big)
+        {
+            lo = byteswap(lo);
+            hi = byteswap(hi);
+        }
+        lo ^= crc;
+
+        crc = TABLE[7][lo & 0xff] ^ TABLE[6][(lo >> 8) & 0xff]
+            ^ TABLE[5][(lo >> 16) & 0xff] ^ TABLE[4][lo >> 24]
+            ^ TABLE[3][hi & 0xff] ^ TABLE[2][(hi >> 8) & 0xff]
+            ^ TABLE[1][(hi >> 16) & 0xff] ^ TABLE[0][hi >> 24];
+    }
+
+    for (; size > 0; ++data, --size)
+    {
+        crc = (crc >> 8) ^ TABLE[0][(crc ^ *data) & 0xff];
+    }
+
+    return crc;
+}
+
+#ifdef METADATA_CRC32C_X64
+
+#ifndef _MSC_VER
+__attribute__((target("sse4.2")))
+#endif
+uint32_t crc32c_sse42(const uint8_t* data, std::size_t size, uint32_t crc) noexcept
+{
+    uint64_t crc64 = crc;
+    for (; size >= 8; data += 8, size -= 8)
+    {
+        uint64_t chunk;
+        std::memcpy(&chunk, data, 8);
+        crc64 = _mm_crc32_u64(crc64, chunk);
+    }
+
+    auto crc32 = static_cast<uint32_t>(crc64);
+    for (; size > 0; ++data, --size)
+    {
+        crc32 = _mm_crc32_u8(crc32, *data);
+    }
+
+    return crc32;
+}
+
+#endif
+
+using Implementation = uint32_t (*)(const uint8_t*, std::size_t, uint32_t) noexcept;
+
+Implementation select_implementation() noexcept
+{
+#ifdef METADATA_CRC32C_X64
+    if (cpu_features().sse42) return crc32c_sse42;
+#endif
+    return crc32c_slicing8;
+}
+
+} // anonymous namespace
+
+uint32_t crc32c(std::span<const uint8_t> data, uint32_t crc) noexcept
+{
+    static const Implementation implementation = select_implementation();
+    return ~implementation(data.data(), data.size(), ~crc);
+}
+
+uint32_t crc32c_portable(std::span<const uint8_t> data, uint32_t crc) noexcept
+{
+    return ~crc32c_slicing8(data.data(), data.size(), ~crc);
+}
+
+bool crc32c_hardware_available() noexcept
+{
+    return cpu_features().sse42;
+}
+
+} // metadata
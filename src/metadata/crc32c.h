@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace metadata
+{
+
+// CRC32C (Castagnoli), as used by iSCSI and ext4. Uses the SSE4.2 crc32
+// instruction when the CPU supports it, a slicing-by-8 table otherwise.
+uint32_t crc32c(std::span<const uint8_t> data, uint32_t crc = 0) noexcept;
+
+// Same, always with the portable implementation.
+uint32_t crc32c_portable(std::span<const uint8_t> data, uint32_t crc = 0) noexcept;
+
+bool crc32c_hardware_available() noexcept;
+
+} // metadata
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace metadata
+{
+
+// Change-only emission. When no field of a frame moved by more than its
+// deadband since the values last sent, and no other block has news, the
+// frame carries the single byte UNCHANGED_MARKER instead of its blocks:
+// viewers keep the values they have. Blocks always end with the 4 bytes magic
+// and legacy frames have 8 bytes, so the marker cannot be mistaken for either.
+//
+// Comparing with the values last sent rather than those of the previous frame
+// keeps slow drifts from hiding under the deadband forever. A keep-alive
+// sends the values at least every keepalive, for viewers that join during a
+// long static stretch.
+
+constexpr uint8_t UNCHANGED_MARKER = 0xA5;
+
+inline bool is_unchanged_frame(std::span<const uint8_t> data) noexcept
+{
+    return data.size() == 1 && data[0] == UNCHANGED_MARKER;
+}
+
+class DeadbandFilter
+{
+    using clock = std::chrono::steady_clock;
+
+    std::vector<double> _deadbands; // by field, 0 sends every change
+    std::vector<double> _sent;
+    clock::duration _keepalive;
+    clock::time_point _last_sent{};
+
+public:
+
+    DeadbandFilter(std::vector<double> deadbands, std::chrono::milliseconds keepalive) :
+        _deadbands{ std::move(deadbands) }, _keepalive{ keepalive } {}
+
+    // The values were never sent, or not for keepalive.
+    bool keepalive_due(clock::time_point now) const noexcept
+    {
+        return _sent.empty() || now - _last_sent >= _keepalive;
+    }
+
+    // A field moved beyond its deadband since the values last sent. Fields
+    // past the configured deadbands use the last one.
+    template<typename T>
+    bool changed(std::span<const T> values) const noexcept
+    {
+        if (values.size() != _sent.size()) return true;
+
+        for (std::size_t i = 0; i < values.size(); ++i)
+        {
+            const auto deadband = _deadbands.empty() ? 0.0 : _deadbands[std::min(i, _deadbands.size() - 1)];
+            if (std::abs(static_cast<double>(values[i]) - _sent[i]) > deadband) return true;
+        }
+        return false;
+    }
+
+    // Records the values of a frame sent in full.
+    template<typename T>
+    void sent(std::span<const T> values, clock::time_point now)
+    {
+        _sent.assign(values.begin(), values.end());
+        _last_sent = now;
+    }
+};
+
+} // metadata
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "varint.h"
+
+namespace metadata
+{
+
+// Delta encoding of a set of int32 fields.
+//
+//   [kind:u8][sequence:u8][value:zigzag varint]...
+//
+// A KEYFRAME carries the absolute values, a DELTA frame carries the
+// difference with the previous frame. A keyframe is sent every
+// keyframe_interval frames so a decoder that lost a frame, or joined late,
+// recovers within that interval. The sequence number lets the decoder notice
+// a missing frame instead of silently applying a delta to the wrong base.
+
+enum class DeltaKind : uint8_t
+{
+    KEYFRAME = 0,
+    DELTA = 1,
+};
+
+class DeltaEncoder
+{
+    uint32_t _keyframe_interval;
+    uint32_t _frames_since_keyframe{ 0 };
+    uint8_t _sequence{ 0 };
+    std::vector<int32_t> _previous;
+
+public:
+
+    explicit DeltaEncoder(uint32_t keyframe_interval) noexcept
+        : _keyframe_interval{ keyframe_interval ? keyframe_interval : 1 } {}
+
+    static constexpr std::size_t max_size(std::size_t field_count) noexcept
+    {
+        return 2 + field_count * MAX_VARINT_SIZE;
+    }
+
+    void force_keyframe() noexcept { _previous.clear(); }
+
+    void encode(std::span<const int32_t> values, std::vector<uint8_t>& data)
+    {
+        const bool keyframe = _previous.size() != values.size()
+            || _frames_since_keyframe + 1 >= _keyframe_interval;
+
+        if (_previous.size() != values.size())
+        {
+            _previous.assign(values.size(), 0);
+        }
+
+        const auto offset = data.size();
+        data.resize(offset + max_size(values.size()));
+
+        auto* out = data.data() + offset;
+        std::size_t n = 0;
+        out[n++] = static_cast<uint8_t>(keyframe ? DeltaKind::KEYFRAME : DeltaKind::DELTA);
+        out[n++] = _sequence++;
+
+        for (std::size_t i = 0; i < values.size(); ++i)
+        {
+            const int64_t delta = keyframe
+                ? int64_t{ values[i] }
+                : int64_t{ values[i] } - _previous[i];
+            n += write_varint(out + n, zigzag_encode(delta));
+            _previous[i] = values[i];
+        }
+
+        data.resize(offset + n);
+        _frames_since_keyframe = keyframe ? 0 : _frames_since_keyframe + 1;
+    }
+};
+
+class DeltaDecoder
+{
+    std::vector<int32_t> _values;
+    uint8_t _last_sequence{ 0 };
+    bool _in_sync{ false };
+
+public:
+
+    // Applies one payload. Returns true when values() holds the state of this
+    // frame, false if the payload is malformed or refers to a frame we missed.
+    bool decode(std::span<const uint8_t> payload)
+    {
+        if (payload.size() < 2) return false;
+
+        const auto kind = static_cast<DeltaKind>(payload[0]);
+        const uint8_t sequence = payload[1];
+        const bool keyframe = kind == DeltaKind::KEYFRAME;
+
+        if (!keyframe && (kind != DeltaKind::DELTA || !_in_sync
+            || sequence != static_cast<uint8_t>(_last_sequence + 1)))
+        {
+            _in_sync = false;
+            return false;
+        }
+
+        std::size_t pos = 2;
+        std::size_t count = 0;
+        for (auto tmp = pos; tmp < payload.size(); ++tmp)
+        {
+            if (!(payload[tmp] & 0x80)) ++count;
+        }
+
+        if (keyframe)
+        {
+            _values.assign(count, 0);
+        }
+        else if (count != _values.size())
+        {
+            _in_sync = false;
+            return false;
+        }
+
+        for (auto& value : _values)
+        {
+            const auto v = read_varint(payload, pos);
+            if (!v)
+            {
+                _in_sync = false;
+                return false;
+            }
+            const int64_t delta = zigzag_decode(*v);
+            value = static_cast<int32_t>(keyframe ? delta : value + delta);
+        }
+
+        _last_sequence = sequence;
+        _in_sync = true;
+        return true;
+    }
+
+    bool in_sync() const noexcept { return _in_sync; }
+    std::span<const int32_t> values() const noexcept { return _values; }
+};
+
+} // metadata
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "aes_gcm.h"
+#include "byte_order.h"
+
+namespace metadata
+{
+
+// AES-GCM encryption of metadata blocks.
+//
+//   [key_id:u8][nonce:12][ciphertext][tag:16]
+//
+// The nonce is the frame ssrc and RTP timestamp followed by a per-publisher
+// block counter, so two blocks of the same frame (or a timestamp wrap) never
+// reuse it. It is carried in the clear because media servers may rewrite the
+// ssrc and timestamp seen by the viewer. key_id and nonce are authenticated
+// as additional data. Keys are rotated by adding a new key id and switching
+// to it; viewers keep the previous keys to decrypt frames still in flight.
+
+constexpr std::size_t ENCRYPTION_HEADER_SIZE = 1 + AesGcm::NONCE_SIZE;
+constexpr std::size_t ENCRYPTION_OVERHEAD = ENCRYPTION_HEADER_SIZE + AesGcm::TAG_SIZE;
+
+// Key contexts by id. Lookups are lock-free; replaced contexts are kept alive
+// until the ring is destroyed since another thread may still be using them.
+class KeyRing
+{
+    std::array<std::atomic<const AesGcm*>, 256> _keys{};
+    std::mutex _mutex;
+    std::vector<std::unique_ptr<AesGcm>> _contexts;
+
+public:
+
+    void add(uint8_t id, std::span<const uint8_t> key)
+    {
+        auto context = std::make_unique<AesGcm>(key);
+
+        std::lock_guard lock(_mutex);
+        _keys[id].store(context.get(), std::memory_order_release);
+        _contexts.push_back(std::move(context));
+    }
+
+    const AesGcm* get(uint8_t id) const noexcept
+    {
+        return _keys[id].load(std::memory_order_acquire);
+    }
+};
+
+class MetadataEncryptor
+{
+    KeyRing _keys;
+    std::atomic<int> _active_key{ -1 };
+    std::atomic<uint32_t> _counter{ 0 };
+
+public:
+
+    void add_key(uint8_t id, std::span<const uint8_t> key) { _keys.add(id, key); }
+
+    // Throws std::invalid_argument when the key was never added, rather than
+    // sending the following blocks in the clear.
+    void set_active_key(uint8_t id)
+    {
+        if (!_keys.get(id)) throw std::invalid_argument("Unknown metadata key id " + std::to_string(id));
+        _active_key.store(id, std::memory_order_release);
+    }
+
+    bool enabled() const noexcept { return _active_key.load(std::memory_order_acquire) >= 0; }
+
+    // Encrypts data[payload_offset..] in place. Returns false, leaving data
+    // untouched, when no key is active.
+    bool seal(uint32_t ssrc, uint32_t timestamp, std::vector<uint8_t>& data, std::size_t payload_offset)
+    {
+        const int key_id = _active_key.load(std::memory_order_acquire);
+        const auto* key = key_id >= 0 ? _keys.get(static_cast<uint8_t>(key_id)) : nullptr;
+        if (!key) return false;
+
+        const auto plain_size = data.size() - payload_offset;
+        data.resize(data.size() + ENCRYPTION_OVERHEAD);
+
+        auto* header = data.data() + payload_offset;
+        std::copy_backward(header, header + plain_size, header + ENCRYPTION_HEADER_SIZE + plain_size);
+
+        AesGcm::Nonce nonce;
+        store_be(nonce.data(), ssrc);
+        store_be(nonce.data() + 4, timestamp);
+        store_be(nonce.data() + 8, _counter.fetch_add(1, std::memory_order_relaxed));
+
+        header[0] = static_cast<uint8_t>(key_id);
+        std::copy(nonce.begin(), nonce.end(), header + 1);
+
+        const auto tag = key->seal(nonce, { header, ENCRYPTION_HEADER_SIZE },
+            { header + ENCRYPTION_HEADER_SIZE, plain_size });
+        std::copy(tag.begin(), tag.end(), header + ENCRYPTION_HEADER_SIZE + plain_size);
+
+        return true;
+    }
+};
+
+class MetadataDecryptor
+{
+    KeyRing _keys;
+    uint64_t _failures{ 0 };
+
+public:
+
+    void add_key(uint8_t id, std::span<const uint8_t> key) { _keys.add(id, key); }
+
+    // Decrypts the payload of an ENCRYPTED block into plain, whose capacity is
+    // reused from frame to frame. Returns nullopt for an unknown key or a
+    // payload that does not authenticate.
+    std::optional<std::span<const uint8_t>> open(std::span<const uint8_t> payload, std::vector<uint8_t>& plain)
+    {
+        if (payload.size() < ENCRYPTION_OVERHEAD) return failed();
+
+        const auto* key = _keys.get(payload[0]);
+        if (!key) return failed();
+
+        AesGcm::Nonce nonce;
+        std::copy_n(payload.begin() + 1, nonce.size(), nonce.begin());
+
+        AesGcm::Tag tag;
+        std::copy(payload.end() - static_cast<std::ptrdiff_t>(tag.size()), payload.end(), tag.begin());
+
+        const auto cipher = payload.subspan(ENCRYPTION_HEADER_SIZE, payload.size() - ENCRYPTION_OVERHEAD);
+        plain.assign(cipher.begin(), cipher.end());
+
+        if (!key->open(nonce, payload.first(ENCRYPTION_HEADER_SIZE), plain, tag)) return failed();
+
+        return std::span<const uint8_t>(plain);
+    }
+
+    // Blocks that could not be decrypted.
+    uint64_t failures() const noexcept { return _failures; }
+
+private:
+
+    std::nullopt_t failed() noexcept
+    {
+        _failures++;
+        return std::nullopt;
+    }
+};
+
+} // metadata
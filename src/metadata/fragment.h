@@ -0,0 +1,272 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "varint.h"
+
+namespace metadata
+{
+
+// Splits messages larger than a per-frame byte budget across consecutive
+// frames. A block holds one or more fragments:
+//
+//   {[message_id][index][total_size][offset][length]:varint [bytes]}...
+//
+// Small messages may share a frame; a large one is spread over as many frames
+// as needed so it never causes a bitrate spike. Fragment sizes vary with the
+// room left in each frame, so the receiver completes a message once it has
+// total_size bytes, using the index to ignore duplicates.
+
+constexpr std::size_t MAX_FRAGMENT_HEADER_SIZE = 5 * 5; // five u32 varints
+
+class Fragmenter
+{
+    std::size_t _budget;
+    std::size_t _max_pending_bytes;
+
+    std::mutex _mutex;
+    std::deque<std::vector<uint8_t>> _pending;
+    std::size_t _pending_bytes{ 0 };
+
+    std::vector<uint8_t> _current;
+    std::size_t _offset{ 0 };
+    uint32_t _index{ 0 };
+    uint32_t _message_id{ 0 };
+
+public:
+
+    // budget: maximum size of the block written in one frame.
+    // max_pending_bytes: messages pushed beyond that are refused.
+    Fragmenter(std::size_t budget, std::size_t max_pending_bytes) noexcept
+        : _budget{ std::max(budget, MAX_FRAGMENT_HEADER_SIZE + 1) }, _max_pending_bytes{ max_pending_bytes } {}
+
+    // Queues a message. Thread-safe. Returns false if the queue is full.
+    bool push(std::vector<uint8_t> message)
+    {
+        if (message.empty()) return true;
+
+        std::lock_guard lock(_mutex);
+        if (_pending_bytes + message.size() > _max_pending_bytes) return false;
+
+        _pending_bytes += message.size();
+        _pending.push_back(std::move(message));
+        return true;
+    }
+
+    // Upper bound of what the next write appends, 0 when nothing is pending.
+    // Only called from the thread that writes.
+    std::size_t next_size()
+    {
+        std::lock_guard lock(_mutex);
+        const auto remaining = _current.size() - _offset + _pending_bytes;
+        if (!remaining) return 0;
+
+        const auto messages = (_offset < _current.size() ? 1 : 0) + _pending.size();
+        return std::min(_budget, remaining + messages * MAX_FRAGMENT_HEADER_SIZE);
+    }
+
+    // Appends at most budget bytes of fragments to data. Returns the number of
+    // bytes written, 0 when nothing is pending.
+    std::size_t write(std::vector<uint8_t>& data)
+    {
+        const auto start = data.size();
+        data.resize(start + _budget);
+
+        std::size_t n = 0;
+        auto* out = data.data() + start;
+
+        while (_budget - n > MAX_FRAGMENT_HEADER_SIZE && next_message())
+        {
+            const auto header_start = n;
+            n += write_varint(out + n, _message_id);
+            n += write_varint(out + n, _index);
+            n += write_varint(out + n, _current.size());
+            n += write_varint(out + n, _offset);
+
+            // Room left once the length varint itself is accounted for.
+            const auto room = _budget - n - varint_size(_budget - n);
+            const auto length = std::min(_current.size() - _offset, room);
+            if (length == 0)
+            {
+                n = header_start;
+                break;
+            }
+
+            n += write_varint(out + n, length);
+            std::copy_n(_current.data() + _offset, length, out + n);
+            n += length;
+
+            _offset += length;
+            _index++;
+        }
+
+        data.resize(start + n);
+        return n;
+    }
+
+private:
+
+    // Makes sure _current has bytes left to send. Returns false when idle.
+    bool next_message()
+    {
+        if (_offset < _current.size()) return true;
+
+        {
+            std::lock_guard lock(_mutex);
+            if (_pending.empty()) return false;
+
+            _current.swap(_pending.front());
+            _pending.pop_front();
+            _pending_bytes -= _current.size();
+        }
+
+        _message_id++;
+        _offset = 0;
+        _index = 0;
+        return true;
+    }
+};
+
+// Rebuilds messages from their fragments. Memory is bounded by max_bytes:
+// incomplete messages are evicted, oldest first, when a new one does not fit
+// or when they are older than timeout.
+class Reassembler
+{
+    using clock = std::chrono::steady_clock;
+
+    struct Partial
+    {
+        uint32_t message_id;
+        std::size_t received;
+        clock::time_point first_seen;
+        std::vector<uint8_t> data;
+        std::vector<bool> fragments;
+    };
+
+    std::size_t _max_bytes;
+    clock::duration _timeout;
+    std::vector<Partial> _partials; // oldest first
+    std::size_t _bytes{ 0 };
+    uint64_t _evicted{ 0 };
+
+public:
+
+    Reassembler(std::size_t max_bytes, std::chrono::milliseconds timeout) noexcept
+        : _max_bytes{ max_bytes }, _timeout{ timeout } {}
+
+    // on_message(message_id, std::span<const uint8_t>) is called for every
+    // message completed by this block. Returns false if the block is malformed.
+    template<typename Callback>
+    bool decode(std::span<const uint8_t> block, Callback&& on_message, clock::time_point now = clock::now())
+    {
+        evict_expired(now);
+
+        std::size_t pos = 0;
+        while (pos < block.size())
+        {
+            uint64_t header[5];
+            for (auto& field : header)
+            {
+                const auto v = read_varint(block, pos);
+                if (!v || *v > UINT32_MAX) return false;
+                field = *v;
+            }
+
+            const auto message_id = static_cast<uint32_t>(header[0]);
+            const auto index = static_cast<std::size_t>(header[1]);
+            const auto total_size = static_cast<std::size_t>(header[2]);
+            const auto offset = static_cast<std::size_t>(header[3]);
+            const auto length = static_cast<std::size_t>(header[4]);
+
+            if (length == 0 || length > block.size() - pos || index >= total_size
+                || offset > total_size || length > total_size - offset)
+            {
+                return false;
+            }
+
+            const auto bytes = block.subspan(pos, length);
+            pos += length;
+
+            if (length == total_size)
+            {
+                on_message(message_id, bytes);
+                continue;
+            }
+
+            auto* partial = find_or_create(message_id, total_size, now);
+            if (!partial) continue;
+
+            if (partial->fragments.size() <= index) partial->fragments.resize(index + 1);
+            if (partial->fragments[index]) continue;
+
+            std::copy(bytes.begin(), bytes.end(), partial->data.begin() + static_cast<std::ptrdiff_t>(offset));
+            partial->fragments[index] = true;
+            partial->received += length;
+
+            if (partial->received == partial->data.size())
+            {
+                on_message(message_id, std::span<const uint8_t>(partial->data));
+                erase(partial);
+            }
+        }
+
+        return true;
+    }
+
+    // Incomplete messages dropped because of the timeout or the memory bound.
+    uint64_t evicted() const noexcept { return _evicted; }
+    std::size_t pending_bytes() const noexcept { return _bytes; }
+
+private:
+
+    Partial* find_or_create(uint32_t message_id, std::size_t total_size, clock::time_point now)
+    {
+        for (auto& partial : _partials)
+        {
+            if (partial.message_id != message_id) continue;
+            return partial.data.size() == total_size ? &partial : nullptr;
+        }
+
+        if (total_size > _max_bytes) return nullptr;
+
+        while (!_partials.empty() && _bytes + total_size > _max_bytes)
+        {
+            _evicted++;
+            erase(&_partials.front());
+        }
+
+        _bytes += total_size;
+        _partials.push_back({
+            .message_id = message_id,
+            .received = 0,
+            .first_seen = now,
+            .data = std::vector<uint8_t>(total_size),
+            .fragments = {},
+        });
+        return &_partials.back();
+    }
+
+    void evict_expired(clock::time_point now)
+    {
+        while (!_partials.empty() && now - _partials.front().first_seen > _timeout)
+        {
+            _evicted++;
+            erase(&_partials.front());
+        }
+    }
+
+    void erase(Partial* partial)
+    {
+        _bytes -= partial->data.size();
+        _partials.erase(_partials.begin() + (partial - _partials.data()));
+    }
+};
+
+} // metadata
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace metadata
+{
+
+// With simulcast or SVC, every layer of a captured frame goes through the
+// frame transformer with the same RTP timestamp, possibly on different encoder
+// threads. TimestampMemo keeps the metadata computed for the last Capacity
+// timestamps so it is computed once and copied into every layer.
+//
+// Entries are reused: compute gets the entry of an evicted timestamp and
+// should clear() and refill its buffers, which then stop allocating once
+// warmed up.
+template<typename Entry, std::size_t Capacity = 8>
+class TimestampMemo
+{
+    struct Slot
+    {
+        uint32_t timestamp{ 0 };
+        bool used{ false };
+        Entry entry{};
+    };
+
+    std::mutex _mutex;
+    std::array<Slot, Capacity> _slots;
+    std::size_t _next{ 0 }; // oldest slot, replaced on the next miss
+    uint64_t _computed{ 0 };
+    uint64_t _reused{ 0 };
+
+public:
+
+    // Calls compute(Entry&) the first time timestamp is seen, then
+    // use(const Entry&). Both run under the lock, which serializes the layers
+    // for that time. Returns true when the entry was reused.
+    template<typename Compute, typename Use>
+    bool get(uint32_t timestamp, Compute&& compute, Use&& use)
+    {
+        std::lock_guard lock(_mutex);
+
+        for (auto& slot : _slots)
+        {
+            if (slot.used && slot.timestamp == timestamp)
+            {
+                _reused++;
+                use(static_cast<const Entry&>(slot.entry));
+                return true;
+            }
+        }
+
+        auto& slot = _slots[_next];
+        _next = (_next + 1) % Capacity;
+
+        slot.timestamp = timestamp;
+        slot.used = true;
+        compute(slot.entry);
+        _computed++;
+
+        use(static_cast<const Entry&>(slot.entry));
+        return false;
+    }
+
+    uint64_t computed()
+    {
+        std::lock_guard lock(_mutex);
+        return _computed;
+    }
+
+    uint64_t reused()
+    {
+        std::lock_guard lock(_mutex);
+        return _reused;
+    }
+};
+
+} // metadata
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#include "batch_encode.h"
+#include "byte_order.h"
+#include "compression.h"
+#include "deadband.h"
+#include "encryption.h"
+#include "position.h"
+#include "schema.h"
+#include "trailer.h"
+#include "versioning.h"
+
+namespace metadata
+{
+
+// Viewer side decoding of what MetadataPublisher appends to a frame, meant to
+// be called from Viewer::Listener::on_frame_metadata. Everything works in
+// place on the frame buffer: no heap allocation and no copy of the payload,
+// except to open encrypted or compressed blocks and the last position kept
+// for unchanged frames.
+// The templates live here; the CRC32C, batch, AES-GCM and LZ decoders they
+// call are compiled into the metadata-viewer static library, which viewer
+// projects link instead of picking translation units from src/metadata.
+
+// Typed view of a payload encoded with Schema. Fields are read from the
+// buffer when accessed, e.g. view.get<&Position::pos_x>().
+template<typename Schema>
+class SchemaView
+{
+    const uint8_t* _data;
+
+    explicit SchemaView(const uint8_t* data) noexcept : _data{ data } {}
+
+public:
+
+    using struct_type = typename Schema::struct_type;
+
+    // Returns nullopt when payload is too short for the schema. Trailing
+    // bytes are ignored so newer publishers can append fields.
+    static std::optional<SchemaView> from(std::span<const uint8_t> payload) noexcept
+    {
+        if (payload.size() < Schema::size) return std::nullopt;
+        return SchemaView{ payload.data() };
+    }
+
+    template<auto Member>
+    auto get() const noexcept
+    {
+        using value_type = typename Field<Member>::value_type;
+        const auto* in = _data + Schema::template offset_of<Member>();
+
+        if constexpr (is_std_array<value_type>::value)
+        {
+            using element_type = typename value_type::value_type;
+            return BigEndianArray<element_type>(in, std::tuple_size_v<value_type>);
+        }
+        else
+        {
+            return load_be<value_type>(in);
+        }
+    }
+
+    // Decodes every field, on the stack.
+    struct_type value() const noexcept { return Schema::read(_data); }
+};
+
+class PositionView
+{
+    SchemaView<PositionSchema> _view;
+
+public:
+
+    explicit PositionView(SchemaView<PositionSchema> view) noexcept : _view{ view } {}
+
+    int32_t pos_x() const noexcept { return _view.get<&Position::pos_x>(); }
+    int32_t pos_y() const noexcept { return _view.get<&Position::pos_y>(); }
+
+    Position value() const noexcept { return _view.value(); }
+};
+
+// Undoes the steps the publisher applies after tagging a block, in reverse:
+// decrypts ENCRYPTED blocks, then decompresses COMPRESSED ones. Opened
+// payloads live in buffers of the opener, whose capacity is reused, until
+// the next open(). Keep one per stream.
+class BlockOpener
+{
+    MetadataDecryptor* _decryptor;
+    const Decompressor* _decompressor;
+    std::vector<uint8_t> _plain;
+    std::vector<uint8_t> _raw;
+    uint64_t _failures{ 0 };
+
+public:
+
+    // Either may be null for streams sent without encryption or compression.
+    BlockOpener(MetadataDecryptor* decryptor, const Decompressor* decompressor) noexcept
+        : _decryptor{ decryptor }, _decompressor{ decompressor } {}
+
+    // Returns the block with both flags cleared, or nullopt when it does not
+    // decrypt or decompress.
+    std::optional<Trailer> open(Trailer block)
+    {
+        if (block.flags & flags::ENCRYPTED)
+        {
+            const auto plain = _decryptor ? _decryptor->open(block.payload, _plain) : std::nullopt;
+            if (!plain) return failed();
+
+            block.payload = *plain;
+            block.flags = static_cast<uint8_t>(block.flags & ~flags::ENCRYPTED);
+        }
+
+        if (block.flags & flags::COMPRESSED)
+        {
+            const auto raw = _decompressor ? _decompressor->decompress(block.payload, _raw) : std::nullopt;
+            if (!raw) return failed();
+
+            block.payload = *raw;
+            block.flags = static_cast<uint8_t>(block.flags & ~flags::COMPRESSED);
+        }
+
+        return block;
+    }
+
+    // Opens block then routes it to its decoder.
+    template<typename Context>
+    bool decode(SchemaDispatcher<Context>& dispatcher, Context& context, const Trailer& block)
+    {
+        const auto opened = open(block);
+        return opened && dispatcher.decode(context, *opened);
+    }
+
+    // Blocks that could not be opened.
+    uint64_t failures() const noexcept { return _failures; }
+
+private:
+
+    std::nullopt_t failed() noexcept
+    {
+        _failures++;
+        return std::nullopt;
+    }
+};
+
+// Reads the blocks of the frames of one stream. Keep one per stream: it counts
+// the corrupted blocks and keeps the last position.
+//
+// With METADATA_DEADBAND the publisher sends the single byte UNCHANGED_MARKER
+// (deadband.h) for frames where nothing moved: the values of the previous
+// frames still hold. read() returns nullopt for it, like for a lost frame,
+// and unchanged() tells them apart; read_position() returns the last
+// position instead.
+class FrameReader
+{
+    BlockReader _blocks;
+    bool _unchanged{ false };
+    std::array<uint8_t, PositionSchema::size> _last_position{};
+    bool _has_position{ false };
+
+public:
+
+    // Calls on_block(Trailer) for every valid block except the position one,
+    // last block first, with the CRC already checked and stripped. Returns the
+    // position block, the one at the start of data, or nullopt when it is
+    // missing or corrupted. Frames from a publisher using the legacy layout (8
+    // bytes, no footer) come back as an untagged block. Blocks are decoded
+    // in the reverse order of the publisher: BlockOpener::open for the
+    // ENCRYPTED and COMPRESSED ones, then a SchemaDispatcher, which removes
+    // the tag, then the stateful DELTA, STATE_SYNC and REDUNDANT decoders,
+    // which all take spans. BlockOpener::decode does the first two steps.
+    template<typename Callback>
+    std::optional<Trailer> read(std::span<const uint8_t> data, Callback&& on_block)
+    {
+        _unchanged = is_unchanged_frame(data);
+        if (_unchanged) return std::nullopt;
+
+        if (!find_trailer(data))
+        {
+            if (data.size() != PositionSchema::size) return std::nullopt;
+            return Trailer{ .version = TRAILER_VERSION, .flags = flags::NONE, .payload = data };
+        }
+
+        std::optional<Trailer> position;
+        _blocks.read(data, [&](const Trailer& trailer)
+        {
+            if (trailer.payload.data() == data.data()) position = trailer;
+            else on_block(trailer);
+        });
+        return position;
+    }
+
+    std::optional<Trailer> read(std::span<const uint8_t> data)
+    {
+        return read(data, [](const Trailer&) {});
+    }
+
+    // Whether the last frame read was UNCHANGED_MARKER rather than missing or
+    // corrupted metadata.
+    bool unchanged() const noexcept { return _unchanged; }
+
+    // Position sent with the fixed encoding, by any version of the position
+    // schema, or with the legacy layout, or the last one for an unchanged
+    // frame. nullopt for other encodings, and for encrypted positions unless
+    // given the opener of the stream.
+    std::optional<PositionView> read_position(std::span<const uint8_t> data)
+    {
+        return read_position(data, nullptr);
+    }
+
+    // The position view points into the buffers of opener when the block
+    // was encrypted or compressed.
+    std::optional<PositionView> read_position(std::span<const uint8_t> data, BlockOpener* opener)
+    {
+        auto block = read(data);
+        if (_unchanged) return _has_position ? view_position(_last_position) : std::nullopt;
+
+        if (block && opener) block = opener->open(*block);
+        if (!block) return std::nullopt;
+
+        const auto tag = split_schema_tag(*block);
+        if (!tag || tag->id != schemas::POSITION || block->flags != flags::NONE) return std::nullopt;
+
+        auto view = view_position(block->payload);
+        if (view)
+        {
+            // 8 bytes, for the unchanged frames that follow.
+            std::copy_n(block->payload.begin(), _last_position.size(), _last_position.begin());
+            _has_position = true;
+        }
+        return view;
+    }
+
+    uint64_t crc_failures() const noexcept { return _blocks.crc_failures(); }
+
+private:
+
+    static std::optional<PositionView> view_position(std::span<const uint8_t> payload) noexcept
+    {
+        auto view = SchemaView<PositionSchema>::from(payload);
+        if (!view) return std::nullopt;
+        return PositionView{ *view };
+    }
+};
+
+} // metadata
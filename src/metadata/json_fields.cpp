@@ -0,0 +1,275 @@
+#include "json_fields.h"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "byte_order.h"
+#include "json_index.h"
+
+namespace metadata
+{
+
+namespace
+{
+
+struct TypeName
+{
+    std::string_view name;
+    JsonFieldType type;
+    uint32_t size;
+};
+
+constexpr TypeName TYPES[] = {
+    { "i8", JsonFieldType::I8, 1 },
+    { "u8", JsonFieldType::U8, 1 },
+    { "i16", JsonFieldType::I16, 2 },
+    { "u16", JsonFieldType::U16, 2 },
+    { "i32", JsonFieldType::I32, 4 },
+    { "u32", JsonFieldType::U32, 4 },
+    { "i64", JsonFieldType::I64, 8 },
+    { "f32", JsonFieldType::F32, 4 },
+    { "f64", JsonFieldType::F64, 8 },
+};
+
+uint64_t hash(std::string_view key) noexcept
+{
+    uint64_t value = 0xcbf29ce484222325ULL; // FNV-1a
+    for (const char c : key)
+    {
+        value = (value ^ static_cast<uint8_t>(c)) * 0x100000001b3ULL;
+    }
+    return value;
+}
+
+bool is_space(char c) noexcept
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+template<typename T>
+bool store_integer(uint8_t* out, std::string_view text) noexcept
+{
+    int64_t integer;
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), integer);
+
+    if (error == std::errc{} && end == text.data() + text.size())
+    {
+        integer = std::clamp<int64_t>(integer, std::numeric_limits<T>::min(), static_cast<int64_t>(std::numeric_limits<T>::max()));
+    }
+    else
+    {
+        // Fractions, exponents and integers out of the int64 range.
+        double number;
+        const auto [real_end, real_error] = std::from_chars(text.data(), text.data() + text.size(), number);
+        if (real_error != std::errc{} || real_end != text.data() + text.size() || std::isnan(number)) return false;
+
+        number = std::clamp(std::round(number), static_cast<double>(std::numeric_limits<T>::min()), static_cast<double>(std::numeric_limits<T>::max()));
+        integer = number >= 0x1p63 ? std::numeric_limits<int64_t>::max() : static_cast<int64_t>(number);
+    }
+
+    store_be(out, static_cast<T>(integer));
+    return true;
+}
+
+template<typename T>
+bool store_real(uint8_t* out, std::string_view text) noexcept
+{
+    double number;
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), number);
+    if (error != std::errc{} || end != text.data() + text.size()) return false;
+
+    store_be(out, static_cast<T>(number));
+    return true;
+}
+
+// Writes the scalar text of a value in the payload.
+bool store(const JsonField& field, std::string_view text, uint8_t* payload) noexcept
+{
+    if (text == "null") return true;
+    if (text == "true") text = "1";
+    else if (text == "false") text = "0";
+
+    auto* out = payload + field.offset;
+    switch (field.type)
+    {
+    case JsonFieldType::I8: return store_integer<int8_t>(out, text);
+    case JsonFieldType::U8: return store_integer<uint8_t>(out, text);
+    case JsonFieldType::I16: return store_integer<int16_t>(out, text);
+    case JsonFieldType::U16: return store_integer<uint16_t>(out, text);
+    case JsonFieldType::I32: return store_integer<int32_t>(out, text);
+    case JsonFieldType::U32: return store_integer<uint32_t>(out, text);
+    case JsonFieldType::I64: return store_integer<int64_t>(out, text);
+    case JsonFieldType::F32: return store_real<float>(out, text);
+    case JsonFieldType::F64: return store_real<double>(out, text);
+    }
+    return false;
+}
+
+} // anonymous namespace
+
+JsonFieldTable::JsonFieldTable(std::string_view spec)
+{
+    while (!spec.empty())
+    {
+        const auto comma = spec.find(',');
+        const auto entry = spec.substr(0, comma);
+        spec = comma == std::string_view::npos ? std::string_view{} : spec.substr(comma + 1);
+
+        const auto colon = entry.rfind(':');
+        const auto* type = colon == std::string_view::npos ? std::end(TYPES)
+            : std::find_if(std::begin(TYPES), std::end(TYPES), [&](const TypeName& t) { return t.name == entry.substr(colon + 1); });
+        if (colon == 0 || type == std::end(TYPES))
+        {
+            throw std::invalid_argument("Invalid JSON field " + std::string(entry) + ", expected name:type");
+        }
+
+        const auto name = entry.substr(0, colon);
+        if (find(name)) throw std::invalid_argument("Duplicate JSON field " + std::string(name));
+
+        _fields.push_back({ std::string(name), type->type, static_cast<uint32_t>(_payload_size) });
+        _payload_size += type->size;
+
+        // Rebuilt as it grows, at most half full so probes stay short.
+        if (_fields.size() > static_cast<std::size_t>(std::numeric_limits<int16_t>::max()))
+        {
+            throw std::invalid_argument("Too many JSON fields");
+        }
+        _slots.assign(std::bit_ceil(std::max<std::size_t>(8, 2 * _fields.size())), -1);
+        for (std::size_t i = 0; i < _fields.size(); ++i)
+        {
+            auto slot = hash(_fields[i].name) & (_slots.size() - 1);
+            while (_slots[slot] >= 0) slot = (slot + 1) & (_slots.size() - 1);
+            _slots[slot] = static_cast<int16_t>(i);
+        }
+    }
+
+    if (_fields.empty()) throw std::invalid_argument("No JSON fields");
+}
+
+const JsonField* JsonFieldTable::find(std::string_view key) const noexcept
+{
+    if (_slots.empty()) return nullptr;
+
+    for (auto slot = hash(key) & (_slots.size() - 1);; slot = (slot + 1) & (_slots.size() - 1))
+    {
+        const auto index = _slots[slot];
+        if (index < 0) return nullptr;
+        if (_fields[static_cast<std::size_t>(index)].name == key) return &_fields[static_cast<std::size_t>(index)];
+    }
+}
+
+double field_value(const JsonField& field, std::span<const uint8_t> payload) noexcept
+{
+    const auto* in = payload.data() + field.offset;
+    switch (field.type)
+    {
+    case JsonFieldType::I8: return load_be<int8_t>(in);
+    case JsonFieldType::U8: return load_be<uint8_t>(in);
+    case JsonFieldType::I16: return load_be<int16_t>(in);
+    case JsonFieldType::U16: return load_be<uint16_t>(in);
+    case JsonFieldType::I32: return load_be<int32_t>(in);
+    case JsonFieldType::U32: return load_be<uint32_t>(in);
+    case JsonFieldType::I64: return static_cast<double>(load_be<int64_t>(in));
+    case JsonFieldType::F32: return load_be<float>(in);
+    case JsonFieldType::F64: return load_be<double>(in);
+    }
+    return 0;
+}
+
+JsonConverter::JsonConverter(JsonFieldTable table) :
+    _table{ std::move(table) },
+    _payload(_table.payload_size()),
+    _scratch(_table.payload_size())
+{
+}
+
+std::size_t JsonConverter::convert(std::string_view text)
+{
+    const auto last = text.rfind('\n');
+    if (last == std::string_view::npos) return 0;
+
+    text = text.substr(0, last + 1);
+    if (_indices.size() < text.size()) _indices.resize(text.size());
+
+    const auto count = index_json(text, _indices.data());
+    const auto* line = _indices.data();
+    for (const auto* index = line; index != _indices.data() + count; ++index)
+    {
+        if (text[*index] != '\n') continue;
+
+        // Blank lines are not records.
+        if (index != line)
+        {
+            if (convert_line(text.data(), line, index))
+            {
+                _payload.swap(_scratch);
+                ++_records;
+            }
+            else
+            {
+                ++_invalid;
+            }
+        }
+        line = index + 1;
+    }
+
+    return text.size();
+}
+
+// Walks the structural characters of one line, index to end, without the
+// newline. The scalar values are the text between a colon and the next comma
+// or closing brace.
+bool JsonConverter::convert_line(const char* text, const uint32_t* index, const uint32_t* end)
+{
+    if (text[*index] != '{') return false;
+    ++index;
+
+    std::memcpy(_scratch.data(), _payload.data(), _payload.size());
+    if (index != end && text[*index] == '}') return index + 1 == end;
+
+    for (;;)
+    {
+        if (end - index < 4 || text[index[0]] != '"' || text[index[1]] != '"' || text[index[2]] != ':') return false;
+
+        const std::string_view key(text + index[0] + 1, index[1] - index[0] - 1);
+        const char* value = text + index[2] + 1;
+        index += 3;
+
+        while (is_space(*value)) ++value;
+        if (value == text + *index && (*value == '"' || *value == '{' || *value == '['))
+        {
+            // Strings, objects and arrays are skipped, up to their last quote or bracket.
+            int depth = 0;
+            bool in_string = false;
+            do
+            {
+                const char c = text[*index++];
+                if (c == '"') in_string = !in_string;
+                else if (c == '{' || c == '[') ++depth;
+                else if (c == '}' || c == ']') --depth;
+            } while ((depth > 0 || in_string) && index != end);
+
+            if (depth || in_string || index == end) return false;
+        }
+        else
+        {
+            const char* value_end = text + *index;
+            while (value_end > value && is_space(value_end[-1])) --value_end;
+            if (value == value_end) return false;
+
+            const auto* field = _table.find(key);
+            if (field && !store(*field, { value, static_cast<std::size_t>(value_end - value) }, _scratch.data())) return false;
+        }
+
+        const char separator = text[*index++];
+        if (separator == '}') return index == end;
+        if (separator != ',' || index == end) return false;
+    }
+}
+
+} // metadata
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace metadata
+{
+
+// Conversion of newline-delimited JSON objects, one per line, into a binary
+// payload described by a field table:
+//
+//   {"x": 0.25, "y": 0.5, "id": 7, "visible": true, "label": "car"}
+//
+// with the table "x:f32,y:f32,id:u16,visible:u8" gives the 11 bytes payload
+//
+//   [x:f32][y:f32][id:u16][visible:u8]
+//
+// big-endian like every other payload. Top-level keys missing from the table,
+// strings, nested objects and arrays are skipped. Fields missing from a line,
+// or null, keep their previous value so feeds can send partial updates.
+// Numbers are rounded and clamped to integer fields, true and false are 1
+// and 0. Keys are compared as written, without decoding escapes.
+
+enum class JsonFieldType : uint8_t
+{
+    I8,
+    U8,
+    I16,
+    U16,
+    I32,
+    U32,
+    I64,
+    F32,
+    F64,
+};
+
+struct JsonField
+{
+    std::string name;
+    JsonFieldType type;
+    uint32_t offset; // in the payload
+};
+
+// Fields by JSON key, compiled once from "name:type,..." into an open
+// addressing hash table. Types: i8, u8, i16, u16, i32, u32, i64, f32, f64.
+class JsonFieldTable
+{
+    std::vector<JsonField> _fields; // in payload order
+    std::vector<int16_t> _slots; // index in _fields, -1 when empty
+    std::size_t _payload_size{ 0 };
+
+public:
+
+    // Throws std::invalid_argument when spec is empty or malformed.
+    explicit JsonFieldTable(std::string_view spec);
+
+    const JsonField* find(std::string_view key) const noexcept;
+
+    std::size_t payload_size() const noexcept { return _payload_size; }
+
+    std::span<const JsonField> fields() const noexcept { return _fields; }
+};
+
+// Value of field in a payload laid out by its table, e.g. to compare two
+// payloads field by field.
+double field_value(const JsonField& field, std::span<const uint8_t> payload) noexcept;
+
+// Runs the structural index (json_index.h) over whole chunks of lines, then
+// walks the structural characters of each line to find the fields.
+class JsonConverter
+{
+    JsonFieldTable _table;
+    std::vector<uint32_t> _indices;
+    std::vector<uint8_t> _payload; // state after the last valid line
+    std::vector<uint8_t> _scratch; // line being converted
+    uint64_t _records{ 0 };
+    uint64_t _invalid{ 0 };
+
+public:
+
+    explicit JsonConverter(JsonFieldTable table);
+
+    // Converts the complete lines of text and returns the number of bytes
+    // used, up to the last newline. The caller keeps the rest for the next
+    // call. Invalid lines are skipped and counted.
+    std::size_t convert(std::string_view text);
+
+    std::span<const uint8_t> payload() const noexcept { return _payload; }
+
+    const JsonFieldTable& table() const noexcept { return _table; }
+
+    uint64_t records() const noexcept { return _records; }
+    uint64_t invalid() const noexcept { return _invalid; }
+
+private:
+
+    bool convert_line(const char* text, const uint32_t* index, const uint32_t* end);
+};
+
+} // metadata
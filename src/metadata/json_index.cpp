@@ -0,0 +1,263 @@
+#include "json_index.h"
+
+#include <bit>
+#include <cstring>
+
+#include "cpu_features.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define METADATA_JSON_X64
+#include <immintrin.h>
+#endif
+
+#if defined(METADATA_JSON_X64) && !defined(_MSC_VER)
+#define METADATA_AVX2_TARGET __attribute__((target("avx2,pclmul")))
+#else
+#define METADATA_AVX2_TARGET
+#endif
+
+namespace metadata
+{
+
+namespace
+{
+
+constexpr std::size_t BLOCK = 64;
+
+// Characters of one 64 bytes block, one bit per byte.
+struct BlockMasks
+{
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t op; // { } [ ] : , and newline
+    uint64_t newline;
+};
+
+// State carried from one block to the next.
+struct Scanner
+{
+    uint64_t prev_escaped{ 0 }; // the first byte of the next block is escaped
+    uint64_t prev_in_string{ 0 }; // all ones when the block ends inside a string
+
+    // Bits of the characters escaped by an odd run of backslashes. Runs
+    // starting on an odd bit are turned into runs starting on an even bit by
+    // the carry of an addition.
+    uint64_t escaped(uint64_t backslash) noexcept
+    {
+        constexpr uint64_t EVEN_BITS = 0x5555555555555555ULL;
+
+        backslash &= ~prev_escaped;
+        const uint64_t follows_escape = backslash << 1 | prev_escaped;
+        const uint64_t odd_starts = backslash & ~EVEN_BITS & ~follows_escape;
+
+        const uint64_t sum = odd_starts + backslash;
+        prev_escaped = sum < odd_starts ? 1 : 0;
+
+        const uint64_t invert_mask = sum << 1;
+        return (EVEN_BITS ^ invert_mask) & follows_escape;
+    }
+
+    template<uint64_t (*PrefixXor)(uint64_t) noexcept>
+    uint64_t structurals(const BlockMasks& masks) noexcept
+    {
+        const uint64_t quote = masks.quote & ~escaped(masks.backslash);
+
+        // Bits from an opening quote, included, to the closing one, excluded.
+        uint64_t in_string = PrefixXor(quote) ^ prev_in_string;
+
+        // Raw newlines cannot appear in JSON strings: a newline inside one
+        // ends the line, so a stray quote does not swallow the next lines.
+        for (uint64_t newlines = masks.newline & in_string; newlines; newlines = masks.newline & in_string)
+        {
+            in_string ^= ~((newlines & (0 - newlines)) - 1);
+        }
+        prev_in_string = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+
+        return (masks.op & ~in_string) | quote;
+    }
+};
+
+inline uint32_t* write_offsets(uint64_t bits, uint32_t base, uint32_t* out) noexcept
+{
+    while (bits)
+    {
+        *out++ = base + static_cast<uint32_t>(std::countr_zero(bits));
+        bits &= bits - 1;
+    }
+    return out;
+}
+
+uint64_t prefix_xor_scalar(uint64_t bits) noexcept
+{
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+BlockMasks classify_scalar(const uint8_t* block) noexcept
+{
+    BlockMasks masks{};
+    for (std::size_t i = 0; i < BLOCK; ++i)
+    {
+        const uint64_t bit = uint64_t{ 1 } << i;
+        switch (block[i])
+        {
+        case '"': masks.quote |= bit; break;
+        case '\\': masks.backslash |= bit; break;
+        case '{': case '}': case '[': case ']': case ':': case ',': masks.op |= bit; break;
+        case '\n': masks.op |= bit; masks.newline |= bit; break;
+        default: break;
+        }
+    }
+    return masks;
+}
+
+std::size_t index_scalar(const uint8_t* data, std::size_t size, const uint8_t* tail, uint32_t* out) noexcept
+{
+    Scanner scanner;
+    auto* const begin = out;
+
+    for (std::size_t offset = 0; offset < size; offset += BLOCK)
+    {
+        const auto* block = offset + BLOCK <= size ? data + offset : tail;
+        const auto bits = scanner.structurals<prefix_xor_scalar>(classify_scalar(block));
+        out = write_offsets(bits, static_cast<uint32_t>(offset), out);
+    }
+    return static_cast<std::size_t>(out - begin);
+}
+
+#ifdef METADATA_JSON_X64
+
+METADATA_AVX2_TARGET uint64_t prefix_xor_clmul(uint64_t bits) noexcept
+{
+    // Carry-less multiplication by all ones xors every bit into the higher ones.
+    const __m128i product = _mm_clmulepi64_si128(_mm_set_epi64x(0, static_cast<int64_t>(bits)), _mm_set1_epi8(-1), 0);
+    return static_cast<uint64_t>(_mm_cvtsi128_si64(product));
+}
+
+METADATA_AVX2_TARGET inline uint64_t movemask64(__m256i low, __m256i high) noexcept
+{
+    return static_cast<uint32_t>(_mm256_movemask_epi8(low)) | static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(high))) << 32;
+}
+
+METADATA_AVX2_TARGET inline uint64_t equal_mask(__m256i low, __m256i high, char c) noexcept
+{
+    const __m256i value = _mm256_set1_epi8(c);
+    return movemask64(_mm256_cmpeq_epi8(low, value), _mm256_cmpeq_epi8(high, value));
+}
+
+METADATA_AVX2_TARGET BlockMasks classify_avx2(const uint8_t* block) noexcept
+{
+    const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+
+    // Setting bit 5 turns [ and ] into { and }.
+    const __m256i case_bit = _mm256_set1_epi8(0x20);
+    const __m256i low_folded = _mm256_or_si256(low, case_bit);
+    const __m256i high_folded = _mm256_or_si256(high, case_bit);
+
+    const uint64_t newline = equal_mask(low, high, '\n');
+    return {
+        .quote = equal_mask(low, high, '"'),
+        .backslash = equal_mask(low, high, '\\'),
+        .op = equal_mask(low_folded, high_folded, '{') | equal_mask(low_folded, high_folded, '}')
+            | equal_mask(low, high, ':') | equal_mask(low, high, ',') | newline,
+        .newline = newline,
+    };
+}
+
+METADATA_AVX2_TARGET std::size_t index_avx2(const uint8_t* data, std::size_t size, const uint8_t* tail, uint32_t* out) noexcept
+{
+    Scanner scanner;
+    auto* const begin = out;
+
+    for (std::size_t offset = 0; offset < size; offset += BLOCK)
+    {
+        const auto* block = offset + BLOCK <= size ? data + offset : tail;
+        const auto bits = scanner.structurals<prefix_xor_clmul>(classify_avx2(block));
+        out = write_offsets(bits, static_cast<uint32_t>(offset), out);
+    }
+    return static_cast<std::size_t>(out - begin);
+}
+
+#endif
+
+using IndexFunction = std::size_t (*)(const uint8_t* data, std::size_t size, const uint8_t* tail, uint32_t* out) noexcept;
+
+struct Implementation
+{
+    const char* name;
+    IndexFunction index;
+};
+
+// Those this CPU can run, fastest first.
+const std::vector<Implementation>& implementations()
+{
+    static const std::vector<Implementation> available = []
+    {
+        std::vector<Implementation> list;
+#ifdef METADATA_JSON_X64
+        const auto& cpu = cpu_features();
+        if (cpu.avx2 && cpu.pclmul) list.push_back({ "avx2", index_avx2 });
+#endif
+        list.push_back({ "scalar", index_scalar });
+        return list;
+    }();
+    return available;
+}
+
+const Implementation& implementation() noexcept
+{
+    static const Implementation selected = implementations().front();
+    return selected;
+}
+
+std::size_t index_with(IndexFunction index, std::string_view json, uint32_t* out) noexcept
+{
+    if (json.empty()) return 0;
+
+    // The last partial block is read from a copy padded with spaces.
+    uint8_t tail[BLOCK];
+    const auto tail_size = json.size() % BLOCK;
+    std::memset(tail, ' ', BLOCK);
+    std::memcpy(tail, json.data() + json.size() - tail_size, tail_size);
+
+    return index(reinterpret_cast<const uint8_t*>(json.data()), json.size(), tail, out);
+}
+
+} // anonymous namespace
+
+std::size_t index_json(std::string_view json, uint32_t* out) noexcept
+{
+    return index_with(implementation().index, json, out);
+}
+
+const char* json_index_implementation() noexcept
+{
+    return implementation().name;
+}
+
+std::vector<const char*> json_index_implementations()
+{
+    std::vector<const char*> names;
+    for (const auto& available : implementations())
+    {
+        names.push_back(available.name);
+    }
+    return names;
+}
+
+std::size_t index_json(std::string_view json, uint32_t* out, std::string_view name) noexcept
+{
+    for (const auto& available : implementations())
+    {
+        if (available.name == name) return index_with(available.index, json, out);
+    }
+    return index_json(json, out);
+}
+
+} // metadata
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace metadata
+{
+
+// First stage of the JSON ingestion (json_fields.h): finds the structural
+// characters of a buffer 64 bytes at a time, with AVX2 and PCLMULQDQ when the
+// CPU supports them and a scalar loop otherwise, so the parser then jumps from
+// one to the next instead of looking at every byte. The structural characters
+// are { } [ ] : , and newline outside strings, and the unescaped quotes that
+// open and close strings.
+//
+// Writes their offsets in increasing order to out, which must have room for
+// json.size() offsets, and returns how many there are. Strings must not span
+// calls: buffers end at the end of a value or of a line. Every newline ends
+// the string it is in, as JSON strings cannot hold raw newlines, so an
+// unterminated string only breaks its own line.
+std::size_t index_json(std::string_view json, uint32_t* out) noexcept;
+
+// Name of the implementation in use: "avx2" or "scalar".
+const char* json_index_implementation() noexcept;
+
+// Implementations this CPU can run, the one in use first, so that
+// metadata-bench-json checks and measures each of them.
+std::vector<const char*> json_index_implementations();
+
+// index_json with the named implementation, one of json_index_implementations.
+std::size_t index_json(std::string_view json, uint32_t* out, std::string_view implementation) noexcept;
+
+} // metadata
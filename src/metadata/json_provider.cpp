@@ -0,0 +1,333 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "json_fields.h"
+#include "provider.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace metadata
+{
+
+namespace
+{
+
+#ifdef _WIN32
+using socket_t = SOCKET;
+constexpr socket_t INVALID_SOCKET_VALUE = INVALID_SOCKET;
+void close_socket(socket_t socket) { closesocket(socket); }
+int poll_sockets(WSAPOLLFD* fds, ULONG count, INT timeout) { return WSAPoll(fds, count, timeout); }
+using pollfd_t = WSAPOLLFD;
+#else
+using socket_t = int;
+constexpr socket_t INVALID_SOCKET_VALUE = -1;
+void close_socket(socket_t socket) { close(socket); }
+int poll_sockets(pollfd* fds, nfds_t count, int timeout) { return poll(fds, count, timeout); }
+using pollfd_t = pollfd;
+#endif
+
+// Ingests newline-delimited JSON from systems that do not speak the binary
+// format, and sends the fields of the table (json_fields.h) as a block of the
+// configured schema. A dedicated thread reads the input, converts all the
+// complete lines it got at once and publishes the resulting payload. Each
+// frame sends the payload if it was updated in the last second.
+//
+// METADATA_JSON_FIELDS : field table, e.g. x:f32,y:f32,id:u16
+// METADATA_JSON_SCHEMA : schema tag of the block, id[:version] (version 1 by default)
+// METADATA_JSON_INPUT : tcp:<port> to accept producers on 127.0.0.1, one at
+//                       a time, or the path of a named pipe or file (POSIX
+//                       only), opened at startup. The standard input closes
+//                       the publisher.
+// METADATA_JSON_DEADBAND : with METADATA_DEADBAND, smallest change of a field
+//                          that counts as a change, either one value for all
+//                          fields or name:value,... (fields not listed
+//                          compare exactly)
+class JsonProvider : public MetadataProvider
+{
+    static constexpr std::size_t BUFFER_SIZE = 1 << 20; // longest line
+    static constexpr int POLL_MS = 100; // to notice the stop request
+    static constexpr auto STALE_AFTER = std::chrono::seconds{ 1 };
+
+    SchemaTag _tag;
+    JsonConverter _converter; // only used by the thread, except table()
+    std::vector<double> _deadbands; // by field, empty to compare bytes
+    std::vector<char> _buffer; // only used by the thread
+    std::size_t _filled{ 0 };
+
+    std::mutex _mutex;
+    std::vector<uint8_t> _latest;
+    std::chrono::steady_clock::time_point _updated{};
+    bool _received{ false };
+
+    std::vector<uint8_t> _sampled; // payload of the frame
+
+    socket_t _listener{ INVALID_SOCKET_VALUE };
+#ifndef _WIN32
+    int _fd{ -1 }; // named pipe or file
+#endif
+    std::jthread _thread;
+
+public:
+
+    JsonProvider(SchemaTag tag, std::string_view fields, const std::string& input, const std::string& deadband) :
+        _tag{ tag },
+        _converter{ JsonFieldTable{ fields } },
+        _deadbands{ parse_deadbands(_converter.table(), deadband) },
+        _buffer(BUFFER_SIZE),
+        _latest(_converter.payload().size()),
+        _sampled(_converter.payload().size())
+    {
+        if (input.starts_with("tcp:"))
+        {
+            listen(static_cast<uint16_t>(std::stoul(input.substr(4))));
+            _thread = std::jthread([this](std::stop_token stop) { accept_producers(stop); });
+        }
+        else
+        {
+#ifdef _WIN32
+            throw std::invalid_argument("METADATA_JSON_INPUT only supports tcp:<port> on Windows");
+#else
+            _fd = open(input.c_str(), O_RDONLY | O_NONBLOCK);
+            if (_fd < 0) throw std::runtime_error("Cannot open the metadata JSON input " + input);
+
+            _thread = std::jthread([this](std::stop_token stop) { read_path(stop); });
+#endif
+        }
+    }
+
+    ~JsonProvider() override
+    {
+        _thread.request_stop();
+        _thread.join();
+        if (_listener != INVALID_SOCKET_VALUE) close_socket(_listener);
+#ifndef _WIN32
+        if (_fd >= 0) close(_fd);
+#endif
+    }
+
+    SchemaTag schema() const noexcept override { return _tag; }
+
+    std::size_t max_size() const noexcept override { return _sampled.size(); }
+
+    bool sample(std::chrono::steady_clock::time_point capture_time) override
+    {
+        std::lock_guard lock(_mutex);
+        if (!_received || _updated < capture_time - STALE_AFTER) return false;
+
+        _sampled = _latest;
+        return true;
+    }
+
+    std::size_t serialize(std::span<uint8_t> out) override
+    {
+        std::memcpy(out.data(), _sampled.data(), _sampled.size());
+        return _sampled.size();
+    }
+
+    bool changed(std::span<const uint8_t> sent, std::span<const uint8_t> payload) const override
+    {
+        if (_deadbands.empty() || sent.size() != payload.size()) return MetadataProvider::changed(sent, payload);
+        if (std::ranges::equal(sent, payload)) return false;
+
+        const auto fields = _converter.table().fields();
+        for (std::size_t i = 0; i < fields.size(); ++i)
+        {
+            const double delta = std::abs(field_value(fields[i], sent) - field_value(fields[i], payload));
+            if (!(delta <= _deadbands[i])) return true; // NaN too
+        }
+        return false;
+    }
+
+private:
+
+    // Throws std::invalid_argument for unknown fields or negative values.
+    static std::vector<double> parse_deadbands(const JsonFieldTable& table, const std::string& value)
+    {
+        if (value.empty()) return {};
+
+        const auto fields = table.fields();
+        std::vector<double> deadbands(fields.size());
+        if (value.find(':') == std::string::npos)
+        {
+            std::ranges::fill(deadbands, std::stod(value));
+        }
+        else
+        {
+            for (std::size_t begin = 0; begin < value.size();)
+            {
+                const auto end = std::min(value.find(',', begin), value.size());
+                const auto entry = value.substr(begin, end - begin);
+                const auto colon = entry.find(':');
+                const auto* field = colon == std::string::npos ? nullptr : table.find(entry.substr(0, colon));
+                if (!field) throw std::invalid_argument("Invalid METADATA_JSON_DEADBAND entry " + entry);
+
+                deadbands[static_cast<std::size_t>(field - fields.data())] = std::stod(entry.substr(colon + 1));
+                begin = end + 1;
+            }
+        }
+
+        if (std::ranges::any_of(deadbands, [](double deadband) { return !(deadband >= 0); }))
+        {
+            throw std::invalid_argument("Invalid METADATA_JSON_DEADBAND " + value);
+        }
+        return deadbands;
+    }
+
+    void listen(uint16_t port)
+    {
+#ifdef _WIN32
+        static const bool winsock = [] { WSADATA wsa; return WSAStartup(MAKEWORD(2, 2), &wsa) == 0; }();
+        if (!winsock) throw std::runtime_error("Cannot initialize Winsock");
+#endif
+        _listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (_listener == INVALID_SOCKET_VALUE) throw std::runtime_error("Cannot create the metadata JSON socket");
+
+        int reuse = 1;
+        setsockopt(_listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+        sockaddr_in local{};
+        local.sin_family = AF_INET;
+        local.sin_port = htons(port);
+        local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(_listener, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) != 0 || ::listen(_listener, 1) != 0)
+        {
+            close_socket(_listener);
+            _listener = INVALID_SOCKET_VALUE;
+            throw std::runtime_error("Cannot listen for metadata JSON on port " + std::to_string(port));
+        }
+    }
+
+    // Returns true when socket has data, or was closed, within POLL_MS.
+    static bool wait_readable(socket_t socket)
+    {
+        pollfd_t fd{};
+        fd.fd = socket;
+        fd.events = POLLIN;
+        return poll_sockets(&fd, 1, POLL_MS) > 0;
+    }
+
+    void accept_producers(std::stop_token stop)
+    {
+        while (!stop.stop_requested())
+        {
+            if (!wait_readable(_listener)) continue;
+
+            const socket_t producer = accept(_listener, nullptr, nullptr);
+            if (producer == INVALID_SOCKET_VALUE) continue;
+
+            _filled = 0;
+            while (!stop.stop_requested())
+            {
+                if (!wait_readable(producer)) continue;
+
+                const auto size = recv(producer, _buffer.data() + _filled, static_cast<int>(_buffer.size() - _filled), 0);
+                if (size <= 0) break;
+
+                received(static_cast<std::size_t>(size));
+            }
+            close_socket(producer);
+        }
+    }
+
+#ifndef _WIN32
+    // Named pipes are read again when the producer reopens them, files once.
+    void read_path(std::stop_token stop)
+    {
+        struct stat info{};
+        const bool pipe = fstat(_fd, &info) == 0 && S_ISFIFO(info.st_mode);
+
+        while (!stop.stop_requested())
+        {
+            if (!wait_readable(_fd)) continue;
+
+            const auto size = read(_fd, _buffer.data() + _filled, _buffer.size() - _filled);
+            if (size > 0)
+            {
+                received(static_cast<std::size_t>(size));
+            }
+            else if (size == 0)
+            {
+                // No producer: wait for one instead of spinning on the hang up.
+                if (!pipe) break;
+                _filled = 0;
+                std::this_thread::sleep_for(std::chrono::milliseconds{ POLL_MS });
+            }
+        }
+    }
+#endif
+
+    void received(std::size_t size)
+    {
+        _filled += size;
+
+        const auto records = _converter.records();
+        const auto used = _converter.convert({ _buffer.data(), _filled });
+        if (used == 0 && _filled == _buffer.size())
+        {
+            _filled = 0; // line too long, dropped
+            return;
+        }
+
+        std::memmove(_buffer.data(), _buffer.data() + used, _filled - used);
+        _filled -= used;
+
+        if (_converter.records() != records)
+        {
+            std::lock_guard lock(_mutex);
+            const auto payload = _converter.payload();
+            std::memcpy(_latest.data(), payload.data(), payload.size());
+            _updated = std::chrono::steady_clock::now();
+            _received = true;
+        }
+    }
+};
+
+SchemaTag parse_schema(const std::string& value)
+{
+    if (value.empty()) throw std::runtime_error("The json provider needs METADATA_JSON_SCHEMA");
+
+    const auto colon = value.find(':');
+    const auto id = std::stoul(value.substr(0, colon));
+    const auto version = colon == std::string::npos ? 1ul : std::stoul(value.substr(colon + 1));
+    if (id > 255 || version < 1 || version > MAX_SCHEMA_VERSION) throw std::invalid_argument("Invalid METADATA_JSON_SCHEMA " + value);
+
+    return { static_cast<uint8_t>(id), static_cast<uint8_t>(version) };
+}
+
+const ProviderRegistration registration("json", []
+{
+    const auto input = get_env("METADATA_JSON_INPUT");
+    const auto fields = get_env("METADATA_JSON_FIELDS");
+    if (input.empty() || fields.empty()) throw std::runtime_error("The json provider needs METADATA_JSON_INPUT and METADATA_JSON_FIELDS");
+
+    return std::make_unique<JsonProvider>(parse_schema(get_env("METADATA_JSON_SCHEMA")), fields, input,
+        get_env("METADATA_JSON_DEADBAND"));
+});
+
+} // anonymous namespace
+
+} // metadata
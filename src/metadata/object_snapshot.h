@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "quantized.h"
+
+namespace metadata
+{
+
+// Latest state of each tracked object, written by one ingestion thread and
+// read by the frame callback without locking. Each slot is a seqlock: the
+// writer makes its version odd while it updates the fields, and a reader
+// retries when the version changed or was odd during its read. Fields are
+// relaxed atomics so a torn read is detected, never undefined.
+template<std::size_t Capacity>
+class ObjectSnapshot
+{
+    using clock = std::chrono::steady_clock;
+
+    struct Slot
+    {
+        std::atomic<uint32_t> version{ 0 };
+        std::atomic<uint32_t> x{ 0 }; // float bits
+        std::atomic<uint32_t> y{ 0 };
+        std::atomic<uint16_t> kind_flags{ 0 };
+        std::atomic<int64_t> updated{ 0 }; // clock ticks, 0 until the first update
+    };
+
+    std::array<Slot, Capacity> _slots;
+
+public:
+
+    static constexpr std::size_t capacity = Capacity;
+
+    // Single writer. Returns false when id is out of range.
+    bool update(std::size_t id, const NormalizedPoint& point, clock::time_point time) noexcept
+    {
+        if (id >= Capacity) return false;
+
+        auto& slot = _slots[id];
+        const auto version = slot.version.load(std::memory_order_relaxed);
+
+        slot.version.store(version + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot.x.store(std::bit_cast<uint32_t>(point.x), std::memory_order_relaxed);
+        slot.y.store(std::bit_cast<uint32_t>(point.y), std::memory_order_relaxed);
+        slot.kind_flags.store(static_cast<uint16_t>(point.kind << 8 | point.flags), std::memory_order_relaxed);
+        slot.updated.store(time.time_since_epoch().count(), std::memory_order_relaxed);
+
+        slot.version.store(version + 2, std::memory_order_release);
+        return true;
+    }
+
+    // Any number of readers. Returns nullopt for an object never updated or
+    // not updated since not_before.
+    std::optional<NormalizedPoint> read(std::size_t id, clock::time_point not_before) const noexcept
+    {
+        const auto& slot = _slots[id];
+
+        for (;;)
+        {
+            const auto version = slot.version.load(std::memory_order_acquire);
+            if (version & 1) continue;
+
+            const auto updated = slot.updated.load(std::memory_order_relaxed);
+            const auto kind_flags = slot.kind_flags.load(std::memory_order_relaxed);
+            const NormalizedPoint point{
+                .x = std::bit_cast<float>(slot.x.load(std::memory_order_relaxed)),
+                .y = std::bit_cast<float>(slot.y.load(std::memory_order_relaxed)),
+                .kind = static_cast<uint8_t>(kind_flags >> 8),
+                .flags = static_cast<uint8_t>(kind_flags),
+            };
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.version.load(std::memory_order_relaxed) != version) continue;
+
+            if (!updated || clock::time_point{ clock::duration{ updated } } < not_before) return std::nullopt;
+            return point;
+        }
+    }
+};
+
+} // metadata
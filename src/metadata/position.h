@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+#include "schema.h"
+
+namespace metadata
+{
+
+// XY position of the bouncing logo, as read by the UE5 player.
+struct Position
+{
+    int32_t pos_x;
+    int32_t pos_y;
+};
+
+using PositionSchema = Schema<Position,
+    Field<&Position::pos_x>,
+    Field<&Position::pos_y>>;
+
+static_assert(PositionSchema::size == 8, "The UE5 player expects 8 bytes of pos_x/pos_y");
+
+// Bump when appending fields to Position, never reorder or remove them.
+constexpr uint8_t POSITION_SCHEMA_VERSION = 1;
+
+} // metadata
@@ -0,0 +1,73 @@
+#include "provider.h"
+
+#include <cstdlib>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace metadata
+{
+
+std::string get_env(const char* name)
+{
+    const char* value = std::getenv(name);
+    return value ? value : "";
+}
+
+ProviderRegistry& ProviderRegistry::instance()
+{
+    static ProviderRegistry registry;
+    return registry;
+}
+
+std::unique_ptr<MetadataProvider> ProviderRegistry::create(const std::string& name) const
+{
+    auto it = _factories.find(name);
+    if (it == _factories.end()) throw std::invalid_argument("Unknown metadata provider " + name);
+
+    return it->second();
+}
+
+std::vector<std::string> ProviderRegistry::names() const
+{
+    std::vector<std::string> names;
+    for (const auto& [name, factory] : _factories)
+    {
+        names.push_back(name);
+    }
+    return names;
+}
+
+void ProviderRegistry::load_library(const std::string& path)
+{
+#ifdef _WIN32
+    auto* module = LoadLibraryA(path.c_str());
+    if (!module) throw std::runtime_error("Cannot load metadata provider library " + path);
+
+    std::shared_ptr<void> library(module, [](void* handle) { FreeLibrary(static_cast<HMODULE>(handle)); });
+    auto symbol = reinterpret_cast<void*>(GetProcAddress(module, REGISTER_PROVIDERS_SYMBOL));
+#else
+    auto* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) throw std::runtime_error("Cannot load metadata provider library " + path + ": " + dlerror());
+
+    std::shared_ptr<void> library(handle, [](void* handle) { dlclose(handle); });
+    auto* symbol = dlsym(handle, REGISTER_PROVIDERS_SYMBOL);
+#endif
+
+    if (!symbol) throw std::runtime_error(path + " does not export " + REGISTER_PROVIDERS_SYMBOL);
+
+    reinterpret_cast<RegisterProvidersFunction>(symbol)(*this);
+    _libraries.push_back(std::move(library));
+}
+
+} // metadata
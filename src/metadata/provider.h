@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "versioning.h"
+
+namespace metadata
+{
+
+// A MetadataProvider contributes one schema-tagged block to every frame,
+// after the position. MetadataPublisher calls it from a single thread:
+//
+//   prepare(context)        once, when the capture format is known
+//   sample(capture_time)    for each frame, takes the state at that time
+//   serialize(out)          right after a successful sample
+//
+// out always has max_size() bytes, so the publisher sizes its buffers once
+// from the providers instead of growing them frame by frame.
+
+struct ProviderContext
+{
+    int32_t width;
+    int32_t height;
+    int fps;
+};
+
+class MetadataProvider
+{
+public:
+
+    virtual ~MetadataProvider() = default;
+
+    virtual SchemaTag schema() const noexcept = 0;
+
+    // Upper bound of what serialize writes.
+    virtual std::size_t max_size() const noexcept = 0;
+
+    virtual void prepare(const ProviderContext& context) {}
+
+    // Returns false when there is nothing to send with this frame.
+    virtual bool sample(std::chrono::steady_clock::time_point capture_time) = 0;
+
+    // Returns the number of bytes written, at most out.size().
+    virtual std::size_t serialize(std::span<uint8_t> out) = 0;
+
+    // With METADATA_DEADBAND, whether payload, just serialized, moved enough
+    // from sent, the payload of the last block of the provider that went out
+    // (empty before the first one), for the frame not to be UNCHANGED_MARKER.
+    // Providers with noisy values override it with their own deadbands; one
+    // returning false leaves its block out of the change test, for values
+    // that move on every frame.
+    virtual bool changed(std::span<const uint8_t> sent, std::span<const uint8_t> payload) const
+    {
+        return !std::ranges::equal(sent, payload);
+    }
+
+    // Inputs dropped as malformed, e.g. a corrupted shared memory ring,
+    // logged on exit. Thread-safe.
+    virtual uint64_t malformed() const noexcept { return 0; }
+};
+
+using ProviderFactory = std::function<std::unique_ptr<MetadataProvider>()>;
+
+class ProviderRegistry;
+
+// Shared objects loaded with load_library export this function, with C
+// linkage, and add their providers to the registry it gets. They must be
+// built with the same compiler and metadata headers as the publisher.
+using RegisterProvidersFunction = void (*)(ProviderRegistry& registry);
+constexpr const char* REGISTER_PROVIDERS_SYMBOL = "metadata_register_providers";
+
+// Providers by name. Built-in providers register themselves at static
+// initialization with a ProviderRegistration.
+class ProviderRegistry
+{
+    std::vector<std::shared_ptr<void>> _libraries; // unloaded after the factories they hold
+    std::map<std::string, ProviderFactory> _factories;
+
+public:
+
+    static ProviderRegistry& instance();
+
+    // Throws std::invalid_argument when name is taken. Inline so that shared
+    // objects do not need to link against the publisher to call it.
+    void add(const std::string& name, ProviderFactory factory)
+    {
+        if (!_factories.emplace(name, std::move(factory)).second)
+        {
+            throw std::invalid_argument("Metadata provider " + name + " is already registered");
+        }
+    }
+
+    // Throws std::invalid_argument when name is unknown.
+    std::unique_ptr<MetadataProvider> create(const std::string& name) const;
+
+    std::vector<std::string> names() const;
+
+    // Loads a shared object (dlopen, LoadLibrary) and calls its
+    // metadata_register_providers. Throws std::runtime_error on failure.
+    void load_library(const std::string& path);
+};
+
+struct ProviderRegistration
+{
+    ProviderRegistration(const std::string& name, ProviderFactory factory)
+    {
+        ProviderRegistry::instance().add(name, std::move(factory));
+    }
+};
+
+// Value of the environment variable name, empty when it is not set. Providers
+// read their configuration with it in their factory.
+std::string get_env(const char* name);
+
+} // metadata
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "bitpack.h"
+#include "varint.h"
+
+namespace metadata
+{
+
+// Resolution independent positions: coordinates are normalized to [0, 1] and
+// quantized to coordinate_bits, the object kind (an enum) and flags take
+// kind_bits and flag_bits. Objects are bit-packed back to back:
+//
+//   [coordinate_bits:u8][kind_bits:u4|flag_bits:u4][count:varint]
+//   {[x:coordinate_bits][y:coordinate_bits][kind:kind_bits][flags:flag_bits]}...
+//
+// A point at 12 bits takes 3 bytes instead of 8 for the pixel pos_x/pos_y.
+// Viewers scale the coordinates to their own render size with to_pixels.
+//
+// Version 2 appends the id of each object, in the order of the points, so
+// viewers follow objects that come and go between frames:
+//
+//   {[object_id:varint]}...
+//
+// Version 1 decoders read the points and ignore the ids.
+
+struct NormalizedPoint
+{
+    float x; // 0 = left edge, 1 = right edge
+    float y; // 0 = top edge, 1 = bottom edge
+    uint8_t kind;
+    uint8_t flags;
+};
+
+struct QuantizationFormat
+{
+    uint8_t coordinate_bits;
+    uint8_t kind_bits{ 0 };
+    uint8_t flag_bits{ 0 };
+
+    std::size_t point_bits() const noexcept
+    {
+        return 2 * std::size_t{ coordinate_bits } + kind_bits + flag_bits;
+    }
+
+    bool valid() const noexcept
+    {
+        return coordinate_bits >= 1 && coordinate_bits <= 24 && kind_bits <= 8 && flag_bits <= 8;
+    }
+};
+
+constexpr uint8_t QUANTIZED_SCHEMA_VERSION = 1;
+constexpr uint8_t QUANTIZED_IDS_SCHEMA_VERSION = 2;
+constexpr std::size_t MAX_OBJECT_ID_SIZE = 3; // varint of a u16
+
+inline uint32_t quantize(float value, unsigned bits) noexcept
+{
+    const auto max = static_cast<double>(bit_mask(bits));
+    const auto clamped = std::isnan(value) ? 0.0 : std::clamp(static_cast<double>(value), 0.0, 1.0);
+    return static_cast<uint32_t>(std::lround(clamped * max));
+}
+
+inline float dequantize(uint32_t value, unsigned bits) noexcept
+{
+    return static_cast<float>(value / static_cast<double>(bit_mask(bits)));
+}
+
+// Scales a normalized coordinate to a render size of extent pixels.
+inline int32_t to_pixels(float value, int32_t extent) noexcept
+{
+    return static_cast<int32_t>(std::lround(static_cast<double>(value) * extent));
+}
+
+class QuantizedEncoder
+{
+    QuantizationFormat _format;
+
+public:
+
+    explicit QuantizedEncoder(QuantizationFormat format) : _format{ format }
+    {
+        if (!format.valid()) throw std::invalid_argument("Quantization needs 1 to 24 coordinate bits and at most 8 kind and flag bits");
+    }
+
+    const QuantizationFormat& format() const noexcept { return _format; }
+
+    std::size_t max_size(std::size_t count) const noexcept
+    {
+        return 2 + MAX_VARINT_SIZE + packed_size(count * _format.point_bits());
+    }
+
+    // With the ids of version 2.
+    std::size_t max_size_with_ids(std::size_t count) const noexcept
+    {
+        return max_size(count) + count * MAX_OBJECT_ID_SIZE;
+    }
+
+    // Kinds and flags wider than their bit width are truncated.
+    void encode(std::span<const NormalizedPoint> points, std::vector<uint8_t>& data) const
+    {
+        const auto offset = data.size();
+        data.resize(offset + max_size(points.size()));
+        data.resize(offset + encode(points, data.data() + offset));
+    }
+
+    // Writes at most max_size(points.size()) bytes to out, returns the size.
+    std::size_t encode(std::span<const NormalizedPoint> points, uint8_t* out) const noexcept
+    {
+        auto* start = out;
+        *out++ = _format.coordinate_bits;
+        *out++ = static_cast<uint8_t>(_format.kind_bits << 4 | _format.flag_bits);
+        out += write_varint(out, points.size());
+
+        BitWriter writer(out);
+        for (const auto& point : points)
+        {
+            writer.write(quantize(point.x, _format.coordinate_bits), _format.coordinate_bits);
+            writer.write(quantize(point.y, _format.coordinate_bits), _format.coordinate_bits);
+            writer.write(point.kind, _format.kind_bits);
+            writer.write(point.flags, _format.flag_bits);
+        }
+
+        return static_cast<std::size_t>(writer.flush() - start);
+    }
+
+    // Version 2, ids[i] is the id of points[i]. Writes at most
+    // max_size_with_ids(points.size()) bytes to out, returns the size.
+    std::size_t encode(std::span<const NormalizedPoint> points, std::span<const uint16_t> ids, uint8_t* out) const noexcept
+    {
+        auto n = encode(points, out);
+        for (const auto id : ids.first(points.size()))
+        {
+            n += write_varint(out + n, id);
+        }
+        return n;
+    }
+};
+
+// Calls on_point(const NormalizedPoint&) for every point of payload, without
+// allocating. Returns false, possibly after some points, when payload is
+// malformed.
+template<typename Callback>
+bool decode_quantized(std::span<const uint8_t> payload, Callback&& on_point)
+{
+    if (payload.size() < 2) return false;
+
+    const QuantizationFormat format{
+        .coordinate_bits = payload[0],
+        .kind_bits = static_cast<uint8_t>(payload[1] >> 4),
+        .flag_bits = static_cast<uint8_t>(payload[1] & 0x0F),
+    };
+    if (!format.valid()) return false;
+
+    std::size_t pos = 2;
+    const auto count = read_varint(payload, pos);
+    if (!count || *count > (payload.size() - pos) * 8 / format.point_bits()) return false;
+
+    BitReader reader(payload.subspan(pos));
+    for (uint64_t i = 0; i < *count; ++i)
+    {
+        const auto x = reader.read(format.coordinate_bits);
+        const auto y = reader.read(format.coordinate_bits);
+        const auto kind = reader.read(format.kind_bits);
+        const auto flags = reader.read(format.flag_bits);
+        if (!x || !y || !kind || !flags) return false;
+
+        on_point(NormalizedPoint{
+            .x = dequantize(*x, format.coordinate_bits),
+            .y = dequantize(*y, format.coordinate_bits),
+            .kind = static_cast<uint8_t>(*kind),
+            .flags = static_cast<uint8_t>(*flags),
+        });
+    }
+    return true;
+}
+
+// Version 2: calls on_object(uint16_t id, const NormalizedPoint&) for every
+// point of payload, without allocating. Returns false, possibly after some
+// objects, when payload is malformed.
+template<typename Callback>
+bool decode_quantized_ids(std::span<const uint8_t> payload, Callback&& on_object)
+{
+    if (payload.size() < 2) return false;
+
+    const auto point_bits = 2 * std::size_t{ payload[0] } + (payload[1] >> 4) + (payload[1] & 0x0F);
+    std::size_t pos = 2;
+    const auto count = read_varint(payload, pos);
+    if (!count || !point_bits || *count > (payload.size() - pos) * 8 / point_bits) return false;
+
+    // The ids follow the bit-packed points.
+    std::size_t id_pos = pos + packed_size(static_cast<std::size_t>(*count) * point_bits);
+    bool ids_valid = true;
+    const bool points_valid = decode_quantized(payload, [&](const NormalizedPoint& point)
+    {
+        const auto id = ids_valid ? read_varint(payload, id_pos) : std::nullopt;
+        if (!id || *id > UINT16_MAX)
+        {
+            ids_valid = false;
+            return;
+        }
+        on_object(static_cast<uint16_t>(*id), point);
+    });
+    return points_valid && ids_valid;
+}
+
+} // metadata
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "varint.h"
+
+namespace metadata
+{
+
+// Redundant transmission of the last samples, so metadata survives the loss
+// of the frame that carried it without any retransmission.
+//
+//   [sequence:varint][count:u8]{[length:varint][sample]}*count
+//
+// Samples are written newest first: the i-th one has sequence (sequence - i).
+// The first sample is always the one of the current frame. At depth 0 the
+// publisher sends the plain sample without this framing and calls restart, so
+// a clean network pays nothing extra.
+
+class RedundancyEncoder
+{
+    std::vector<std::vector<uint8_t>> _history; // ring of previous samples
+    std::size_t _head{ 0 };
+    std::size_t _stored{ 0 };
+    uint32_t _sequence{ 0 };
+    std::atomic<uint32_t> _depth{ 0 };
+
+public:
+
+    explicit RedundancyEncoder(std::size_t max_depth, std::size_t sample_capacity = 64)
+        : _history(max_depth)
+    {
+        for (auto& sample : _history) sample.reserve(sample_capacity);
+    }
+
+    std::size_t max_depth() const noexcept { return _history.size(); }
+
+    // Number of previous samples repeated in each frame. Safe to call from
+    // any thread, typically on_stats_report.
+    void set_depth(uint32_t depth) noexcept
+    {
+        _depth.store(std::min<uint32_t>(depth, static_cast<uint32_t>(_history.size())), std::memory_order_relaxed);
+    }
+
+    uint32_t depth() const noexcept { return _depth.load(std::memory_order_relaxed); }
+
+    // The sample of this frame went out without the framing. The viewers got
+    // the previous samples without a sequence, so they are not repeated.
+    void restart() noexcept { _stored = 0; }
+
+    void encode(std::span<const uint8_t> sample, std::vector<uint8_t>& data)
+    {
+        const std::size_t depth = std::min<std::size_t>(this->depth(), _stored);
+        const auto sequence = _sequence++;
+
+        std::size_t size = MAX_VARINT_SIZE + 1 + MAX_VARINT_SIZE + sample.size();
+        for (std::size_t i = 0; i < depth; ++i)
+        {
+            size += MAX_VARINT_SIZE + previous(i).size();
+        }
+
+        const auto offset = data.size();
+        data.resize(offset + size);
+
+        auto* out = data.data() + offset;
+        std::size_t n = write_varint(out, sequence);
+        out[n++] = static_cast<uint8_t>(depth + 1);
+
+        auto write_sample = [&](std::span<const uint8_t> bytes)
+        {
+            n += write_varint(out + n, bytes.size());
+            std::copy(bytes.begin(), bytes.end(), out + n);
+            n += bytes.size();
+        };
+
+        write_sample(sample);
+        for (std::size_t i = 0; i < depth; ++i)
+        {
+            write_sample(previous(i));
+        }
+
+        data.resize(offset + n);
+
+        if (!_history.empty())
+        {
+            _head = (_head + 1) % _history.size();
+            _history[_head].assign(sample.begin(), sample.end());
+            _stored = std::min(_stored + 1, _history.size());
+        }
+    }
+
+private:
+
+    // i = 0 is the sample of the previous frame
+    const std::vector<uint8_t>& previous(std::size_t i) const noexcept
+    {
+        return _history[(_head + _history.size() - i) % _history.size()];
+    }
+};
+
+// Picks the redundancy depth from the receiver reports: the smallest depth
+// for which losing a sample and all of its copies (fraction_lost^(depth+1))
+// stays under the target residual loss. One extra copy is added on long round
+// trips, where NACK retransmissions come too late to save the frame.
+class RedundancyController
+{
+    double _loss{ 0 };
+    uint32_t _max_depth;
+
+public:
+
+    static constexpr double RESIDUAL_LOSS_TARGET = 1e-3;
+    static constexpr double LONG_RTT_SECONDS = 0.25;
+    static constexpr double SMOOTHING = 0.3;
+
+    explicit RedundancyController(uint32_t max_depth) noexcept : _max_depth{ max_depth } {}
+
+    uint32_t update(double fraction_lost, double round_trip_time) noexcept
+    {
+        _loss = SMOOTHING * std::clamp(fraction_lost, 0.0, 1.0) + (1 - SMOOTHING) * _loss;
+
+        if (_loss < RESIDUAL_LOSS_TARGET) return 0;
+        if (_loss >= 1.0) return _max_depth;
+
+        auto depth = static_cast<uint32_t>(std::ceil(std::log(RESIDUAL_LOSS_TARGET) / std::log(_loss))) - 1;
+        if (round_trip_time >= LONG_RTT_SECONDS) depth++;
+
+        return std::min(depth, _max_depth);
+    }
+};
+
+// Receiver side: delivers every sample not seen yet, oldest first, so that
+// samples of lost frames are recovered from the following ones.
+class RedundancyDecoder
+{
+    uint32_t _last_sequence{ 0 };
+    bool _started{ false };
+    uint64_t _recovered{ 0 };
+
+public:
+
+    // on_sample(sequence, std::span<const uint8_t>) is called for each new
+    // sample. Returns false if the payload is malformed.
+    template<typename Callback>
+    bool decode(std::span<const uint8_t> payload, Callback&& on_sample)
+    {
+        std::size_t pos = 0;
+        const auto sequence = read_varint(payload, pos);
+        if (!sequence || pos >= payload.size()) return false;
+
+        const auto newest = static_cast<uint32_t>(*sequence);
+        const std::size_t count = payload[pos++];
+        if (count == 0) return false;
+
+        // Offsets of the samples, newest first, bounded by the u8 count.
+        std::size_t offsets[256];
+        std::size_t lengths[256];
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const auto length = read_varint(payload, pos);
+            if (!length || *length > payload.size() - pos) return false;
+            offsets[i] = pos;
+            lengths[i] = static_cast<std::size_t>(*length);
+            pos += lengths[i];
+        }
+
+        // Number of samples we have not delivered yet, using serial number
+        // arithmetic so the sequence may wrap.
+        std::size_t fresh = count;
+        if (_started)
+        {
+            const auto ahead = static_cast<int32_t>(newest - _last_sequence);
+            if (ahead <= 0) return true;
+            fresh = std::min<std::size_t>(count, static_cast<uint32_t>(ahead));
+        }
+
+        for (std::size_t i = fresh; i-- > 0;)
+        {
+            on_sample(newest - static_cast<uint32_t>(i), payload.subspan(offsets[i], lengths[i]));
+        }
+
+        if (_started) _recovered += fresh - 1;
+        _last_sequence = newest;
+        _started = true;
+        return true;
+    }
+
+    // Samples delivered from a redundant copy because their own frame was lost.
+    uint64_t recovered() const noexcept { return _recovered; }
+};
+
+} // metadata
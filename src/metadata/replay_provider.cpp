@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include "provider.h"
+#include "telemetry_file.h"
+
+namespace metadata
+{
+
+namespace
+{
+
+// Replays a telemetry recording (telemetry_file.h) in real time from the
+// first frame, instead of live data. Each frame carries the last record at or
+// before its capture time, as a block of the schema of the recording.
+//
+// METADATA_REPLAY_FILE : path of the recording
+// METADATA_REPLAY_LOOP : 0 to stop at the end of the recording (default 1)
+class ReplayProvider : public MetadataProvider
+{
+    TelemetryFile _file;
+    bool _loop;
+    std::optional<std::chrono::steady_clock::time_point> _start;
+    std::span<const uint8_t> _payload;
+
+public:
+
+    ReplayProvider(const std::string& path, bool loop) : _file{ path }, _loop{ loop }
+    {
+        if (_file.empty()) throw std::runtime_error("No telemetry records in " + path);
+    }
+
+    SchemaTag schema() const noexcept override { return _file.schema(); }
+
+    std::size_t max_size() const noexcept override { return _file.max_payload_size(); }
+
+    bool sample(std::chrono::steady_clock::time_point capture_time) override
+    {
+        if (!_start) _start = capture_time;
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(capture_time - *_start).count();
+        const auto duration = _file.end_time_us() - _file.start_time_us();
+
+        if (elapsed < 0) return false;
+        if (elapsed > duration)
+        {
+            if (!_loop) return false;
+            elapsed %= duration + 1;
+        }
+
+        const auto record = _file.find(_file.start_time_us() + elapsed);
+        if (!record) return false;
+
+        _payload = record->payload;
+        return true;
+    }
+
+    std::size_t serialize(std::span<uint8_t> out) override
+    {
+        const auto size = std::min(_payload.size(), out.size());
+        std::memcpy(out.data(), _payload.data(), size);
+        return size;
+    }
+};
+
+const ProviderRegistration registration("replay", []
+{
+    const auto path = get_env("METADATA_REPLAY_FILE");
+    if (path.empty()) throw std::runtime_error("The replay provider needs METADATA_REPLAY_FILE");
+
+    return std::make_unique<ReplayProvider>(path, get_env("METADATA_REPLAY_LOOP") != "0");
+});
+
+} // anonymous namespace
+
+} // metadata
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace metadata
+{
+
+// Maps the RTP timestamps of the frame transformer to the steady clock.
+//
+// Video RTP timestamps count the capture time at 90 kHz from an unknown
+// origin. Each frame reaches the transformer some encode latency after its
+// capture, so arrival - rtp_time = origin + latency. The smallest value over
+// the last frames is the best estimate of the origin, reached by the frame
+// encoded the fastest; the capture time of a frame is then its RTP time plus
+// that origin. A sliding window rather than an all-time minimum follows the
+// drift between the two clocks. The estimate stays late by the shortest
+// encode latency of the window, a few milliseconds, but that bias is constant
+// where the latency of each frame is not.
+//
+// Not thread-safe, call it from where the frames are serialized.
+class RtpClock
+{
+public:
+
+    using clock = std::chrono::steady_clock;
+
+    static constexpr std::size_t WINDOW = 64; // frames
+
+private:
+
+    int64_t _clock_rate;
+    bool _started{ false };
+    uint32_t _last_timestamp{ 0 };
+    int64_t _unwrapped{ 0 }; // _last_timestamp without the 32 bits wraparound
+    std::array<clock::duration, WINDOW> _offsets{};
+    std::size_t _count{ 0 };
+
+public:
+
+    explicit RtpClock(int64_t clock_rate = 90000) noexcept : _clock_rate{ clock_rate } {}
+
+    // Returns the estimated capture time of the frame with rtp_timestamp that
+    // reached the transformer at arrival.
+    clock::time_point capture_time(uint32_t rtp_timestamp, clock::time_point arrival) noexcept
+    {
+        const auto rtp_time = to_duration(unwrap(rtp_timestamp));
+
+        _offsets[_count++ % WINDOW] = arrival.time_since_epoch() - rtp_time;
+        const auto filled = std::min(_count, WINDOW);
+        const auto origin = *std::min_element(_offsets.begin(), _offsets.begin() + static_cast<std::ptrdiff_t>(filled));
+
+        return clock::time_point{ origin + rtp_time };
+    }
+
+private:
+
+    int64_t unwrap(uint32_t timestamp) noexcept
+    {
+        if (_started)
+        {
+            _unwrapped += static_cast<int32_t>(timestamp - _last_timestamp);
+        }
+        else
+        {
+            _unwrapped = timestamp;
+            _started = true;
+        }
+
+        _last_timestamp = timestamp;
+        return _unwrapped;
+    }
+
+    clock::duration to_duration(int64_t ticks) const noexcept
+    {
+        const auto seconds = ticks / _clock_rate;
+        const auto remainder = ticks % _clock_rate;
+
+        return std::chrono::duration_cast<clock::duration>(std::chrono::seconds{ seconds }
+            + std::chrono::nanoseconds{ remainder * 1'000'000'000 / _clock_rate });
+    }
+};
+
+} // metadata
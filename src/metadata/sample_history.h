@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+
+namespace metadata
+{
+
+// The last Capacity samples of a producer, ordered by their capture_time
+// member, to look up the state at the capture time of a frame in O(log n).
+// Fixed storage, nothing is allocated. Not thread-safe.
+template<typename T, std::size_t Capacity>
+class SampleHistory
+{
+    std::array<T, Capacity> _samples{};
+    std::size_t _first{ 0 };
+    std::size_t _size{ 0 };
+
+public:
+
+    using time_point = decltype(T::capture_time);
+
+    // Samples surrounding a time. before == after when time is outside of the
+    // history, then fraction is 0.
+    struct Bracket
+    {
+        const T* before;
+        const T* after;
+        double fraction; // position of time between before (0) and after (1)
+    };
+
+    // Replaces the oldest sample when full. Samples older than the newest one
+    // are ignored to keep the history ordered.
+    void push(const T& sample) noexcept
+    {
+        if (_size && sample.capture_time < at(_size - 1).capture_time) return;
+
+        if (_size == Capacity)
+        {
+            _samples[_first] = sample;
+            _first = (_first + 1) % Capacity;
+        }
+        else
+        {
+            _samples[(_first + _size++) % Capacity] = sample;
+        }
+    }
+
+    std::size_t size() const noexcept { return _size; }
+
+    // Returns nullopt when the history is empty.
+    std::optional<Bracket> find(time_point time) const noexcept
+    {
+        if (!_size) return std::nullopt;
+
+        if (time <= at(0).capture_time) return Bracket{ &at(0), &at(0), 0.0 };
+        if (time >= at(_size - 1).capture_time) return Bracket{ &at(_size - 1), &at(_size - 1), 0.0 };
+
+        // First sample after time, there is one at or before it.
+        std::size_t low = 1, high = _size - 1;
+        while (low < high)
+        {
+            const auto mid = low + (high - low) / 2;
+            if (at(mid).capture_time <= time) low = mid + 1;
+            else high = mid;
+        }
+
+        const auto& before = at(low - 1);
+        const auto& after = at(low);
+        const auto span = std::chrono::duration<double>(after.capture_time - before.capture_time).count();
+        const auto fraction = span > 0 ? std::chrono::duration<double>(time - before.capture_time).count() / span : 0.0;
+
+        return Bracket{ &before, &after, fraction };
+    }
+
+private:
+
+    const T& at(std::size_t index) const noexcept { return _samples[(_first + index) % Capacity]; }
+};
+
+} // metadata
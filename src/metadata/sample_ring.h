@@ -0,0 +1,144 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace metadata
+{
+
+// Bounded lock-free queue between the threads producing metadata samples
+// (trackers, sensor readers, ...) and the frame transformer callback. Based
+// on Vyukov's bounded queue: each cell carries a sequence number telling
+// whether it is ready to be written or read, so push and pop only CAS the
+// tail and head counters.
+//
+// When the queue is full, push drops the oldest sample instead of waiting:
+// a slow consumer costs samples, never blocks a producer, and a slow producer
+// never blocks the encoder. Dropped samples are counted as overruns.
+template<typename T, std::size_t Capacity>
+class SampleRing
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    static_assert(std::is_trivially_copyable_v<T>, "Samples are copied in and out of the ring");
+
+    static constexpr std::size_t MASK = Capacity - 1;
+
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    // Counters on their own cache lines, producers and consumer hammer them.
+    alignas(64) std::atomic<std::size_t> _tail{ 0 };
+    alignas(64) std::atomic<std::size_t> _head{ 0 };
+    alignas(64) std::atomic<uint64_t> _overruns{ 0 };
+    std::array<Cell, Capacity> _cells;
+
+public:
+
+    SampleRing() noexcept
+    {
+        for (std::size_t i = 0; i < Capacity; ++i)
+        {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    SampleRing(const SampleRing&) = delete;
+    SampleRing& operator=(const SampleRing&) = delete;
+
+    // Safe from any number of threads. Returns false when an older sample was
+    // dropped to make room.
+    bool push(const T& value) noexcept
+    {
+        bool dropped = false;
+        auto pos = _tail.load(std::memory_order_relaxed);
+
+        for (;;)
+        {
+            auto& cell = _cells[pos & MASK];
+            const auto sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence - pos);
+
+            if (diff == 0)
+            {
+                if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.value = value;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return !dropped;
+                }
+            }
+            else if (diff < 0)
+            {
+                // Full: discard the oldest sample and try again.
+                T oldest;
+                if (pop(oldest))
+                {
+                    _overruns.fetch_add(1, std::memory_order_relaxed);
+                    dropped = true;
+                }
+                pos = _tail.load(std::memory_order_relaxed);
+            }
+            else
+            {
+                pos = _tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Returns false when the ring is empty. Producers also pop to drop the
+    // oldest sample, so this is safe from any thread too.
+    bool pop(T& value) noexcept
+    {
+        auto pos = _head.load(std::memory_order_relaxed);
+
+        for (;;)
+        {
+            auto& cell = _cells[pos & MASK];
+            const auto sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence - (pos + 1));
+
+            if (diff == 0)
+            {
+                if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    value = cell.value;
+                    cell.sequence.store(pos + Capacity, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = _head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Calls on_sample(const T&) for the queued samples, oldest first, at most
+    // Capacity of them so busy producers cannot keep the caller looping.
+    // Never blocks nor allocates. Returns the number of samples.
+    template<typename Callback>
+    std::size_t drain(Callback&& on_sample)
+    {
+        std::size_t count = 0;
+        for (T value; count < Capacity && pop(value); ++count)
+        {
+            on_sample(static_cast<const T&>(value));
+        }
+        return count;
+    }
+
+    // Samples dropped because the ring was full.
+    uint64_t overruns() const noexcept { return _overruns.load(std::memory_order_relaxed); }
+};
+
+} // metadata
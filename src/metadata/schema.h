@@ -0,0 +1,103 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "batch_encode.h"
+#include "byte_order.h"
+
+namespace metadata
+{
+
+template<typename T>
+struct is_std_array : std::false_type {};
+
+template<typename T, std::size_t N>
+struct is_std_array<std::array<T, N>> : std::true_type {};
+
+// A Field binds a struct member to its big-endian wire representation.
+// std::array members are converted in one pass by the batch encoders.
+// Usage: Field<&Position::pos_x>
+template<auto Member>
+struct Field;
+
+template<typename Struct, typename T, T Struct::*Member>
+struct Field<Member>
+{
+    using struct_type = Struct;
+    using value_type = T;
+
+    static constexpr std::size_t size = sizeof(T);
+
+    static void store(const Struct& value, uint8_t* out) noexcept
+    {
+        if constexpr (is_std_array<T>::value)
+        {
+            store_be_array(std::span<const typename T::value_type>(value.*Member), out);
+        }
+        else
+        {
+            store_be(out, value.*Member);
+        }
+    }
+
+    static void load(Struct& value, const uint8_t* in) noexcept
+    {
+        if constexpr (is_std_array<T>::value)
+        {
+            load_be_array(in, std::span<typename T::value_type>(value.*Member));
+        }
+        else
+        {
+            value.*Member = load_be<T>(in);
+        }
+    }
+};
+
+// A Schema is the ordered list of fields of a payload. Its size is known at
+// compile time so a frame only needs a single resize of the output vector.
+template<typename Struct, typename... Fields>
+struct Schema
+{
+    using struct_type = Struct;
+
+    static constexpr std::size_t field_count = sizeof...(Fields);
+    static constexpr std::size_t size = (std::size_t{ 0 } + ... + Fields::size);
+
+    // Offset of the field bound to Member in the encoded payload.
+    template<auto Member>
+    static constexpr std::size_t offset_of() noexcept
+    {
+        static_assert((std::is_same_v<Field<Member>, Fields> || ...), "Member is not a field of this schema");
+
+        std::size_t offset = 0;
+        bool found = false;
+        ((found = found || std::is_same_v<Field<Member>, Fields>, offset += found ? 0 : Fields::size), ...);
+        return offset;
+    }
+
+    static void write(const Struct& value, uint8_t* out) noexcept
+    {
+        ((Fields::store(value, out), out += Fields::size), ...);
+    }
+
+    static void write(const Struct& value, std::vector<uint8_t>& data)
+    {
+        const auto offset = data.size();
+        data.resize(offset + size);
+        write(value, data.data() + offset);
+    }
+
+    static Struct read(const uint8_t* in) noexcept
+    {
+        Struct value{};
+        ((Fields::load(value, in), in += Fields::size), ...);
+        return value;
+    }
+};
+
+} // metadata
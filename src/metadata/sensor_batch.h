@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "batch_encode.h"
+#include "byte_order.h"
+
+namespace metadata
+{
+
+// Batches the samples of a high-rate sensor (IMU, tracker, ...) received
+// since the previous frame into a single block:
+//
+//   [sensor_id:u8][channels:u8][count:u16][base_offset_us:i32][time_unit_us:u16]
+//   [time_offset:u16] x count
+//   [channel 0:f32] x count ... [channel N-1:f32] x count
+//
+// base_offset_us is the time of the first sample relative to the capture of
+// the frame, time_offset the time of each sample after the first one in
+// time_unit_us. Columns keep each channel contiguous so they are converted to
+// big-endian in one pass by the batch encoders.
+
+template<std::size_t Channels>
+struct SensorSample
+{
+    std::chrono::steady_clock::time_point capture_time;
+    std::array<float, Channels> values;
+};
+
+constexpr std::size_t SENSOR_BATCH_HEADER_SIZE = 1 + 1 + 2 + 4 + 2;
+constexpr uint8_t SENSOR_BATCH_SCHEMA_VERSION = 1;
+
+template<std::size_t Channels, std::size_t Capacity>
+class SensorBatch
+{
+    static_assert(Channels >= 1 && Channels <= 255, "The channel count is a u8");
+    static_assert(Capacity <= 65535, "The sample count is a u16");
+
+    using clock = std::chrono::steady_clock;
+
+    uint8_t _sensor_id;
+    std::chrono::microseconds _time_unit;
+    clock::time_point _base;
+    std::array<uint16_t, Capacity> _offsets;
+    std::array<std::array<float, Capacity>, Channels> _columns;
+    std::size_t _count{ 0 };
+    uint64_t _dropped{ 0 };
+
+public:
+
+    static constexpr std::size_t sample_size = 2 + 4 * Channels;
+    static constexpr std::size_t max_size = SENSOR_BATCH_HEADER_SIZE + Capacity * sample_size;
+
+    // time_unit bounds the precision and the range of the offsets in a batch,
+    // 65535 units from the first sample. 10 us covers 655 ms.
+    explicit SensorBatch(uint8_t sensor_id, std::chrono::microseconds time_unit = std::chrono::microseconds{ 10 }) noexcept
+        : _sensor_id{ sensor_id }, _time_unit{ std::max(time_unit, std::chrono::microseconds{ 1 }) } {}
+
+    // Samples past Capacity or out of the offset range are dropped and
+    // counted. Returns false for them.
+    bool add(const SensorSample<Channels>& sample) noexcept
+    {
+        if (!_count) _base = sample.capture_time;
+
+        const auto offset = (sample.capture_time - _base) / _time_unit;
+        if (_count == Capacity || offset < 0 || offset > 65535)
+        {
+            _dropped++;
+            return false;
+        }
+
+        _offsets[_count] = static_cast<uint16_t>(offset);
+        for (std::size_t channel = 0; channel < Channels; ++channel)
+        {
+            _columns[channel][_count] = sample.values[channel];
+        }
+        _count++;
+        return true;
+    }
+
+    std::size_t size() const noexcept { return _count; }
+    bool empty() const noexcept { return !_count; }
+    uint64_t dropped() const noexcept { return _dropped; }
+
+    // Bytes write appends for the samples added so far.
+    std::size_t block_size() const noexcept { return SENSOR_BATCH_HEADER_SIZE + _count * sample_size; }
+
+    // Appends the block of the oldest max_samples samples, all by default,
+    // and keeps the others for the next block. frame_time is the capture
+    // time of the frame carrying it.
+    void write(clock::time_point frame_time, std::vector<uint8_t>& data, std::size_t max_samples = Capacity)
+    {
+        const auto count = std::min(_count, max_samples);
+        const auto offset = data.size();
+        data.resize(offset + SENSOR_BATCH_HEADER_SIZE + count * sample_size);
+
+        const auto base_offset = std::chrono::duration_cast<std::chrono::microseconds>(_base - frame_time).count();
+
+        auto* out = data.data() + offset;
+        out[0] = _sensor_id;
+        out[1] = static_cast<uint8_t>(Channels);
+        store_be(out + 2, static_cast<uint16_t>(count));
+        store_be(out + 4, static_cast<int32_t>(std::clamp<int64_t>(base_offset, INT32_MIN, INT32_MAX)));
+        store_be(out + 8, static_cast<uint16_t>(std::min<int64_t>(_time_unit.count(), 65535)));
+        out += SENSOR_BATCH_HEADER_SIZE;
+
+        store_be_array(std::span<const uint16_t>(_offsets.data(), count), out);
+        out += count * 2;
+
+        for (const auto& column : _columns)
+        {
+            store_be_array(std::span<const float>(column.data(), count), out);
+            out += count * 4;
+        }
+
+        // The samples left start the next batch.
+        const auto rest = _count - count;
+        if (rest)
+        {
+            const auto first = _offsets[count];
+            _base += first * _time_unit;
+            for (std::size_t i = 0; i < rest; ++i)
+            {
+                _offsets[i] = static_cast<uint16_t>(_offsets[count + i] - first);
+            }
+            for (auto& column : _columns)
+            {
+                std::copy(column.begin() + count, column.begin() + _count, column.begin());
+            }
+        }
+        _count = rest;
+    }
+};
+
+// Reads a sensor batch block in place.
+class SensorBatchView
+{
+    std::span<const uint8_t> _payload;
+    std::size_t _count;
+    std::size_t _channels;
+
+    SensorBatchView(std::span<const uint8_t> payload, std::size_t count, std::size_t channels) noexcept
+        : _payload{ payload }, _count{ count }, _channels{ channels } {}
+
+public:
+
+    // Returns nullopt when payload is too short for its header.
+    static std::optional<SensorBatchView> from(std::span<const uint8_t> payload) noexcept
+    {
+        if (payload.size() < SENSOR_BATCH_HEADER_SIZE) return std::nullopt;
+
+        const std::size_t channels = payload[1];
+        const std::size_t count = load_be<uint16_t>(payload.data() + 2);
+        if (!channels || payload.size() < SENSOR_BATCH_HEADER_SIZE + count * (2 + 4 * channels)) return std::nullopt;
+
+        return SensorBatchView{ payload, count, channels };
+    }
+
+    uint8_t sensor_id() const noexcept { return _payload[0]; }
+    std::size_t channels() const noexcept { return _channels; }
+    std::size_t size() const noexcept { return _count; }
+
+    // Time of a sample relative to the capture of the frame.
+    std::chrono::microseconds time_offset(std::size_t index) const noexcept
+    {
+        const auto base = load_be<int32_t>(_payload.data() + 4);
+        const auto unit = load_be<uint16_t>(_payload.data() + 8);
+        return std::chrono::microseconds{ int64_t{ base } + int64_t{ offsets()[index] } * unit };
+    }
+
+    BigEndianArray<uint16_t> offsets() const noexcept
+    {
+        return { _payload.data() + SENSOR_BATCH_HEADER_SIZE, _count };
+    }
+
+    BigEndianArray<float> channel(std::size_t index) const noexcept
+    {
+        return { _payload.data() + SENSOR_BATCH_HEADER_SIZE + _count * (2 + 4 * index), _count };
+    }
+};
+
+} // metadata
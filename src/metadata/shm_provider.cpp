@@ -0,0 +1,211 @@
+// Shared memory ingestion relies on POSIX shm_open, the provider is not
+// available on Windows.
+#ifndef _WIN32
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include "../client/metadata_shm.h"
+#include "provider.h"
+
+namespace metadata
+{
+
+namespace
+{
+
+constexpr uint32_t MAX_PAYLOAD = 64 * 1024; // METADATA_SHM_MAX_PAYLOAD bound
+
+// Ingests the records a co-located process writes into a shared memory ring
+// (see client/metadata_shm.h, and the metadata-shm-client library to write
+// them). The publisher owns the ring: it creates it at startup and removes it
+// on exit. Each frame takes the latest record due at the capture time, copies
+// its payload out of the ring and frees the records up to it. Records from the
+// future stay in the ring for later frames.
+//
+// The payload is copied once, into the block the publisher then tags,
+// compresses and encrypts in its own buffers for every simulcast layer.
+// Lending the ring instead would hold records back from the producer until
+// the last layer is sent, for a copy of a few kilobytes.
+//
+// Record times are CLOCK_MONOTONIC microseconds, the clock of
+// std::chrono::steady_clock with libstdc++ and libc++.
+//
+// METADATA_SHM_NAME : name of the ring (default /metadata-publisher)
+// METADATA_SHM_MAX_PAYLOAD : largest payload the producer may write, which
+//                            sizes the frame buffers (default 4096, up to
+//                            65536)
+class ShmProvider : public MetadataProvider
+{
+    static constexpr uint32_t CAPACITY = 1 << 20;
+    static constexpr std::size_t SIZE = MC_SHM_HEADER_SIZE + CAPACITY;
+
+    std::string _name;
+    uint32_t _max_payload;
+    mc_shm_header* _header{ nullptr };
+    const uint8_t* _data{ nullptr };
+    uint64_t _record{ 0 }; // position of the record sampled
+    uint64_t _consumed{ 0 }; // read_pos to publish once it is serialized
+    mc_shm_record_header _current{};
+    std::optional<uint64_t> _dropped_at; // write_pos of the last corruption
+    std::atomic<uint64_t> _corruptions{ 0 };
+
+public:
+
+    ShmProvider(std::string name, uint32_t max_payload) : _name(std::move(name)), _max_payload{ max_payload }
+    {
+        // A ring left over by a publisher that crashed is replaced.
+        shm_unlink(_name.c_str());
+
+        const int fd = shm_open(_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0) throw std::runtime_error("Cannot create the metadata shared memory " + _name);
+
+        void* memory = ftruncate(fd, SIZE) == 0 ? mmap(nullptr, SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (memory == MAP_FAILED)
+        {
+            shm_unlink(_name.c_str());
+            throw std::runtime_error("Cannot map the metadata shared memory " + _name);
+        }
+
+        // Fresh pages are zeroed, the positions start at 0.
+        _header = static_cast<mc_shm_header*>(memory);
+        _header->capacity = CAPACITY;
+        _header->max_payload = _max_payload;
+        _header->version = MC_SHM_VERSION;
+        std::atomic_ref(_header->magic).store(MC_SHM_MAGIC, std::memory_order_release);
+        _data = static_cast<const uint8_t*>(memory) + MC_SHM_HEADER_SIZE;
+    }
+
+    ~ShmProvider() override
+    {
+        munmap(_header, SIZE);
+        shm_unlink(_name.c_str());
+    }
+
+    SchemaTag schema() const noexcept override { return { _current.schema_id, _current.schema_version }; }
+
+    std::size_t max_size() const noexcept override { return _max_payload; }
+
+    bool sample(std::chrono::steady_clock::time_point capture_time) override
+    {
+        const auto capture_us = std::chrono::duration_cast<std::chrono::microseconds>(capture_time.time_since_epoch()).count();
+        const uint64_t write_pos = std::atomic_ref(_header->write_pos).load(std::memory_order_acquire);
+        uint64_t pos = std::atomic_ref(_header->read_pos).load(std::memory_order_relaxed);
+
+        // The producer is another process: a write_pos that moved back, is
+        // more than the ring ahead or not aligned, or a record running past
+        // the end of the data, was not written by the client library. The ring
+        // contents are dropped, which also bounds the walk below to CAPACITY
+        // bytes.
+        if (write_pos % MC_SHM_RECORD_ALIGNMENT || write_pos - pos > CAPACITY)
+        {
+            drop(write_pos);
+            return false;
+        }
+
+        bool found = false;
+        while (pos != write_pos)
+        {
+            const auto offset = pos & (CAPACITY - 1);
+            mc_shm_record_header record;
+            std::memcpy(&record, _data + offset, sizeof(record));
+
+            const uint64_t size = (MC_SHM_RECORD_HEADER_SIZE + uint64_t{ record.length } + MC_SHM_RECORD_ALIGNMENT - 1) & ~uint64_t{ MC_SHM_RECORD_ALIGNMENT - 1 };
+            if (record.length > _max_payload || size > write_pos - pos || offset + size > CAPACITY)
+            {
+                drop(write_pos);
+                return false;
+            }
+
+            if (!(record.flags & MC_SHM_FLAG_PADDING))
+            {
+                if (record.time_us > capture_us) break;
+
+                _record = pos;
+                _current = record;
+                found = true;
+            }
+            pos += size;
+        }
+
+        if (found)
+        {
+            // Freed once serialize copied the payload out.
+            _consumed = pos;
+        }
+        else if (pos != std::atomic_ref(_header->read_pos).load(std::memory_order_relaxed))
+        {
+            release(pos); // only padding
+        }
+        return found;
+    }
+
+    std::size_t serialize(std::span<uint8_t> out) override
+    {
+        std::memcpy(out.data(), _data + ((_record + MC_SHM_RECORD_HEADER_SIZE) & (CAPACITY - 1)), _current.length);
+        release(_consumed);
+        return _current.length;
+    }
+
+    // Corruptions of the ring, each counted once however many frames see it.
+    uint64_t malformed() const noexcept override { return _corruptions.load(std::memory_order_relaxed); }
+
+private:
+
+    // Drops the ring contents up to write_pos, rounded down so that read_pos
+    // stays aligned and record headers never straddle the end of the data.
+    void drop(uint64_t write_pos) noexcept
+    {
+        if (_dropped_at != write_pos)
+        {
+            _dropped_at = write_pos;
+            _corruptions.fetch_add(1, std::memory_order_relaxed);
+        }
+        release(write_pos & ~uint64_t{ MC_SHM_RECORD_ALIGNMENT - 1 });
+    }
+
+    // Hands the space up to pos back to the producer, and wakes it up if it
+    // waits for it.
+    void release(uint64_t pos) noexcept
+    {
+        std::atomic_ref(_header->read_pos).store(pos, std::memory_order_release);
+        std::atomic_ref(_header->space_futex).fetch_add(1, std::memory_order_seq_cst);
+        if (std::atomic_ref(_header->producer_waiting).load(std::memory_order_seq_cst))
+        {
+#ifdef __linux__
+            syscall(SYS_futex, &_header->space_futex, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#endif
+        }
+    }
+};
+
+const ProviderRegistration registration("shm", []
+{
+    const auto name = get_env("METADATA_SHM_NAME");
+    const auto max_payload = get_env("METADATA_SHM_MAX_PAYLOAD");
+
+    const auto size = max_payload.empty() ? 4096ul : std::stoul(max_payload);
+    if (size == 0 || size > MAX_PAYLOAD) throw std::invalid_argument("Invalid METADATA_SHM_MAX_PAYLOAD " + max_payload);
+
+    return std::make_unique<ShmProvider>(name.empty() ? "/metadata-publisher" : name, static_cast<uint32_t>(size));
+});
+
+} // anonymous namespace
+
+} // metadata
+
+#endif
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "varint.h"
+
+namespace metadata
+{
+
+// State synchronisation of a set of int32 fields.
+//
+//   SNAPSHOT: [kind:u8][generation:varint][field_count:varint][value:zigzag varint]...
+//   UPDATE:   [kind:u8][generation:varint][sequence:varint][field_count:varint]
+//             [changed bitmap:(field_count+7)/8 bytes][value:zigzag varint]... (changed fields only)
+//
+// A snapshot carries the whole state and starts a new generation. Updates only
+// carry the fields that changed since the previous frame and are numbered
+// within their generation, so a decoder notices any lost update and stays out
+// of sync until the next snapshot. Snapshots are sent every snapshot_frames
+// frames or snapshot_period, whichever comes first.
+
+enum class StateSyncKind : uint8_t
+{
+    SNAPSHOT = 0,
+    UPDATE = 1,
+};
+
+class StateSyncEncoder
+{
+    using clock = std::chrono::steady_clock;
+
+    uint32_t _snapshot_frames;
+    clock::duration _snapshot_period;
+    clock::time_point _last_snapshot{};
+    uint32_t _generation{ 0 };
+    uint32_t _sequence{ 0 };
+    std::vector<int32_t> _previous;
+
+public:
+
+    StateSyncEncoder(uint32_t snapshot_frames, std::chrono::milliseconds snapshot_period) noexcept
+        : _snapshot_frames{ snapshot_frames ? snapshot_frames : 1 }, _snapshot_period{ snapshot_period } {}
+
+    static constexpr std::size_t max_size(std::size_t field_count) noexcept
+    {
+        return 1 + 3 * MAX_VARINT_SIZE + (field_count + 7) / 8 + field_count * MAX_VARINT_SIZE;
+    }
+
+    void force_snapshot() noexcept { _previous.clear(); }
+
+    void encode(std::span<const int32_t> values, std::vector<uint8_t>& data)
+    {
+        const auto now = clock::now();
+        const bool snapshot = _previous.size() != values.size()
+            || _sequence + 1 >= _snapshot_frames
+            || now - _last_snapshot >= _snapshot_period;
+
+        const auto offset = data.size();
+        data.resize(offset + max_size(values.size()));
+
+        auto* out = data.data() + offset;
+        std::size_t n = 0;
+
+        if (snapshot)
+        {
+            _generation++;
+            _sequence = 0;
+            _last_snapshot = now;
+            _previous.assign(values.begin(), values.end());
+
+            out[n++] = static_cast<uint8_t>(StateSyncKind::SNAPSHOT);
+            n += write_varint(out + n, _generation);
+            n += write_varint(out + n, values.size());
+            for (auto value : values)
+            {
+                n += write_varint(out + n, zigzag_encode(value));
+            }
+        }
+        else
+        {
+            _sequence++;
+
+            out[n++] = static_cast<uint8_t>(StateSyncKind::UPDATE);
+            n += write_varint(out + n, _generation);
+            n += write_varint(out + n, _sequence);
+            n += write_varint(out + n, values.size());
+
+            auto* bitmap = out + n;
+            const auto bitmap_size = (values.size() + 7) / 8;
+            std::fill_n(bitmap, bitmap_size, uint8_t{ 0 });
+            n += bitmap_size;
+
+            for (std::size_t i = 0; i < values.size(); ++i)
+            {
+                if (values[i] == _previous[i]) continue;
+
+                bitmap[i / 8] |= static_cast<uint8_t>(1 << (i % 8));
+                n += write_varint(out + n, zigzag_encode(values[i]));
+                _previous[i] = values[i];
+            }
+        }
+
+        data.resize(offset + n);
+    }
+};
+
+class StateSyncDecoder
+{
+    std::vector<int32_t> _values;
+    uint64_t _generation{ 0 };
+    uint64_t _sequence{ 0 };
+    uint64_t _out_of_sync_count{ 0 };
+    bool _in_sync{ false };
+
+public:
+
+    enum class Status
+    {
+        SNAPSHOT,    // full state received
+        UPDATED,     // changed fields applied
+        OUT_OF_SYNC, // an update was missed, waiting for the next snapshot
+        MALFORMED,
+    };
+
+    Status decode(std::span<const uint8_t> payload)
+    {
+        if (payload.empty()) return Status::MALFORMED;
+
+        std::size_t pos = 1;
+        const auto generation = read_varint(payload, pos);
+        if (!generation) return Status::MALFORMED;
+
+        switch (static_cast<StateSyncKind>(payload[0]))
+        {
+        case StateSyncKind::SNAPSHOT:
+            return decode_snapshot(payload, pos, *generation);
+        case StateSyncKind::UPDATE:
+            return decode_update(payload, pos, *generation);
+        }
+        return Status::MALFORMED;
+    }
+
+    bool in_sync() const noexcept { return _in_sync; }
+    uint64_t generation() const noexcept { return _generation; }
+    uint64_t out_of_sync_count() const noexcept { return _out_of_sync_count; }
+    std::span<const int32_t> values() const noexcept { return _values; }
+
+private:
+
+    Status out_of_sync() noexcept
+    {
+        if (_in_sync) _out_of_sync_count++;
+        _in_sync = false;
+        return Status::OUT_OF_SYNC;
+    }
+
+    Status decode_snapshot(std::span<const uint8_t> payload, std::size_t pos, uint64_t generation)
+    {
+        const auto count = read_varint(payload, pos);
+        if (!count || *count > payload.size() - pos) return Status::MALFORMED;
+
+        _values.resize(static_cast<std::size_t>(*count));
+        for (auto& value : _values)
+        {
+            const auto v = read_varint(payload, pos);
+            if (!v)
+            {
+                _in_sync = false;
+                return Status::MALFORMED;
+            }
+            value = static_cast<int32_t>(zigzag_decode(*v));
+        }
+
+        _generation = generation;
+        _sequence = 0;
+        _in_sync = true;
+        return Status::SNAPSHOT;
+    }
+
+    Status decode_update(std::span<const uint8_t> payload, std::size_t pos, uint64_t generation)
+    {
+        const auto sequence = read_varint(payload, pos);
+        const auto count = read_varint(payload, pos);
+        if (!sequence || !count) return Status::MALFORMED;
+
+        if (!_in_sync || generation != _generation || *sequence != _sequence + 1 || *count != _values.size())
+        {
+            return out_of_sync();
+        }
+
+        const auto bitmap_size = (_values.size() + 7) / 8;
+        if (payload.size() - pos < bitmap_size) return Status::MALFORMED;
+
+        const auto* bitmap = payload.data() + pos;
+        pos += bitmap_size;
+
+        for (std::size_t i = 0; i < _values.size(); ++i)
+        {
+            if (!(bitmap[i / 8] & (1 << (i % 8)))) continue;
+
+            const auto v = read_varint(payload, pos);
+            if (!v)
+            {
+                _in_sync = false;
+                return Status::MALFORMED;
+            }
+            _values[i] = static_cast<int32_t>(zigzag_decode(*v));
+        }
+
+        _sequence = *sequence;
+        return Status::UPDATED;
+    }
+};
+
+} // metadata
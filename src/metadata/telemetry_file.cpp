@@ -0,0 +1,252 @@
+#include "telemetry_file.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "byte_order.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace metadata
+{
+
+namespace
+{
+
+constexpr std::size_t INDEX_ENTRY_SIZE = 8 + 8;
+constexpr std::size_t INDEX_FOOTER_SIZE = 8 + 4;
+
+// Maps the whole file read-only. The mapping lives as long as the returned
+// pointer.
+std::shared_ptr<const void> map_file(const std::string& path, std::size_t& size)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("Cannot open telemetry file " + path);
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        throw std::runtime_error("Invalid telemetry file " + path);
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) throw std::runtime_error("Cannot map telemetry file " + path);
+
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!view) throw std::runtime_error("Cannot map telemetry file " + path);
+
+    size = static_cast<std::size_t>(file_size.QuadPart);
+    return std::shared_ptr<const void>(view, [](const void* view) { UnmapViewOfFile(view); });
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open telemetry file " + path);
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        close(fd);
+        throw std::runtime_error("Invalid telemetry file " + path);
+    }
+
+    const auto length = static_cast<std::size_t>(info.st_size);
+    void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) throw std::runtime_error("Cannot map telemetry file " + path);
+
+    // Lookups jump around the file.
+    madvise(view, length, MADV_RANDOM);
+
+    size = length;
+    return std::shared_ptr<const void>(view, [length](const void* view) { munmap(const_cast<void*>(view), length); });
+#endif
+}
+
+} // anonymous namespace
+
+TelemetryWriter::TelemetryWriter(const std::string& path, SchemaTag schema) : _file{ path, std::ios::binary }, _path{ path }
+{
+    if (!_file) throw std::runtime_error("Cannot write telemetry file " + path);
+
+    uint8_t header[TELEMETRY_HEADER_SIZE]{};
+    store_be(header, TELEMETRY_MAGIC);
+    header[4] = TELEMETRY_VERSION;
+    header[5] = schema.id;
+    header[6] = schema.version;
+
+    _file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    if (!_file) throw std::runtime_error("Cannot write telemetry file " + path);
+}
+
+void TelemetryWriter::write(int64_t time_us, std::span<const uint8_t> payload)
+{
+    if (time_us < _last_time_us) throw std::invalid_argument("Telemetry records must be in time order");
+    if (payload.size() > UINT32_MAX) throw std::invalid_argument("Telemetry record too large");
+
+    if (_records % TELEMETRY_INDEX_INTERVAL == 0)
+    {
+        _index.emplace_back(time_us, _offset);
+    }
+
+    uint8_t header[TELEMETRY_RECORD_HEADER_SIZE];
+    store_be(header, time_us);
+    store_be(header + 8, static_cast<uint32_t>(payload.size()));
+
+    _file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    _file.write(reinterpret_cast<const char*>(payload.data()), static_cast<std::streamsize>(payload.size()));
+    if (!_file) throw std::runtime_error("Cannot write telemetry file " + _path);
+
+    _offset += sizeof(header) + payload.size();
+    _records++;
+    _last_time_us = time_us;
+    _max_payload_size = std::max(_max_payload_size, static_cast<uint32_t>(payload.size()));
+}
+
+void TelemetryWriter::close()
+{
+    for (const auto& [time_us, offset] : _index)
+    {
+        uint8_t entry[INDEX_ENTRY_SIZE];
+        store_be(entry, time_us);
+        store_be(entry + 8, offset);
+        _file.write(reinterpret_cast<const char*>(entry), sizeof(entry));
+    }
+
+    uint8_t footer[INDEX_FOOTER_SIZE];
+    store_be(footer, static_cast<uint64_t>(_index.size()));
+    store_be(footer + 8, TELEMETRY_INDEX_MAGIC);
+    _file.write(reinterpret_cast<const char*>(footer), sizeof(footer));
+
+    uint8_t max_payload_size[4];
+    store_be(max_payload_size, _max_payload_size);
+    _file.seekp(8);
+    _file.write(reinterpret_cast<const char*>(max_payload_size), sizeof(max_payload_size));
+
+    _file.close();
+    if (!_file) throw std::runtime_error("Cannot write telemetry file " + _path);
+}
+
+TelemetryFile::TelemetryFile(const std::string& path)
+{
+    std::size_t size = 0;
+    _mapping = map_file(path, size);
+    _data = { static_cast<const uint8_t*>(_mapping.get()), size };
+
+    if (_data.size() < TELEMETRY_HEADER_SIZE || load_be<uint32_t>(_data.data()) != TELEMETRY_MAGIC || _data[4] != TELEMETRY_VERSION)
+    {
+        throw std::runtime_error("Invalid telemetry file " + path);
+    }
+
+    _schema = { _data[5], _data[6] };
+    _max_payload_size = load_be<uint32_t>(_data.data() + 8);
+
+    if (!load_index())
+    {
+        build_index();
+    }
+
+    if (!_index.empty())
+    {
+        _start_time_us = _index.front().first;
+
+        // The last record is after the last index entry.
+        for (auto offset = static_cast<std::size_t>(_index.back().second); auto record = record_at(offset);)
+        {
+            _end_time_us = record->time_us;
+            offset = static_cast<std::size_t>(record->payload.data() - _data.data()) + record->payload.size();
+        }
+    }
+}
+
+std::optional<TelemetryFile::Record> TelemetryFile::find(int64_t time_us) const noexcept
+{
+    auto entry = std::upper_bound(_index.begin(), _index.end(), time_us,
+        [](int64_t time_us, const auto& entry) { return time_us < entry.first; });
+    if (entry == _index.begin()) return std::nullopt;
+
+    auto offset = static_cast<std::size_t>((--entry)->second);
+    auto found = record_at(offset);
+
+    while (found)
+    {
+        offset = static_cast<std::size_t>(found->payload.data() - _data.data()) + found->payload.size();
+        const auto next = record_at(offset);
+        if (!next || next->time_us > time_us) break;
+        found = next;
+    }
+    return found;
+}
+
+std::optional<TelemetryFile::Record> TelemetryFile::record_at(std::size_t offset) const noexcept
+{
+    if (offset < TELEMETRY_HEADER_SIZE || offset > _records_end || _records_end - offset < TELEMETRY_RECORD_HEADER_SIZE) return std::nullopt;
+
+    const auto* header = _data.data() + offset;
+    const std::size_t length = load_be<uint32_t>(header + 8);
+    if (_records_end - offset - TELEMETRY_RECORD_HEADER_SIZE < length) return std::nullopt;
+
+    return Record{ load_be<int64_t>(header), _data.subspan(offset + TELEMETRY_RECORD_HEADER_SIZE, length) };
+}
+
+bool TelemetryFile::load_index() noexcept
+{
+    if (_data.size() < TELEMETRY_HEADER_SIZE + INDEX_FOOTER_SIZE) return false;
+
+    const auto* footer = _data.data() + _data.size() - INDEX_FOOTER_SIZE;
+    if (load_be<uint32_t>(footer + 8) != TELEMETRY_INDEX_MAGIC) return false;
+
+    const auto count = load_be<uint64_t>(footer);
+    const auto available = (_data.size() - TELEMETRY_HEADER_SIZE - INDEX_FOOTER_SIZE) / INDEX_ENTRY_SIZE;
+    if (count > available) return false;
+
+    _records_end = _data.size() - INDEX_FOOTER_SIZE - static_cast<std::size_t>(count) * INDEX_ENTRY_SIZE;
+
+    const auto* entry = _data.data() + _records_end;
+    _index.resize(static_cast<std::size_t>(count));
+    for (auto& [time_us, offset] : _index)
+    {
+        time_us = load_be<int64_t>(entry);
+        offset = load_be<uint64_t>(entry + 8);
+        entry += INDEX_ENTRY_SIZE;
+    }
+    return true;
+}
+
+void TelemetryFile::build_index()
+{
+    _records_end = _data.size();
+    _max_payload_size = 0;
+
+    std::size_t offset = TELEMETRY_HEADER_SIZE;
+    for (std::size_t count = 0; auto record = record_at(offset); ++count)
+    {
+        if (count % TELEMETRY_INDEX_INTERVAL == 0)
+        {
+            _index.emplace_back(record->time_us, offset);
+        }
+
+        _max_payload_size = std::max(_max_payload_size, record->payload.size());
+        offset += TELEMETRY_RECORD_HEADER_SIZE + record->payload.size();
+    }
+
+    // A truncated last record is left out.
+    _records_end = offset;
+}
+
+} // metadata
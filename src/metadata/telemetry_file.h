@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "versioning.h"
+
+namespace metadata
+{
+
+// Recorded telemetry, replayed into live streams by the replay provider.
+// Every record is the payload of one block of the same schema:
+//
+//   header  ["MCTL"][version:u8][schema_id:u8][schema_version:u8][0:u8][max_payload_size:u32][0:u32]
+//   records [time_us:i64][length:u32][payload] ...  sorted by time_us
+//   index   [time_us:i64][offset:u64] ...  [count:u64]["MCTI"]
+//
+// The sparse index has one entry every TELEMETRY_INDEX_INTERVAL records. It
+// is optional: TelemetryFile rebuilds it with one pass over the records when
+// a recording was cut before TelemetryWriter::close.
+
+constexpr uint32_t TELEMETRY_MAGIC = 0x4D43544C; // "MCTL"
+constexpr uint32_t TELEMETRY_INDEX_MAGIC = 0x4D435449; // "MCTI"
+constexpr uint8_t TELEMETRY_VERSION = 1;
+constexpr std::size_t TELEMETRY_HEADER_SIZE = 16;
+constexpr std::size_t TELEMETRY_RECORD_HEADER_SIZE = 8 + 4;
+constexpr std::size_t TELEMETRY_INDEX_INTERVAL = 256;
+
+class TelemetryWriter
+{
+    std::ofstream _file;
+    std::string _path;
+    uint64_t _offset{ TELEMETRY_HEADER_SIZE };
+    uint64_t _records{ 0 };
+    uint32_t _max_payload_size{ 0 };
+    int64_t _last_time_us{ INT64_MIN };
+    std::vector<std::pair<int64_t, uint64_t>> _index;
+
+public:
+
+    // Throws std::runtime_error on I/O errors.
+    TelemetryWriter(const std::string& path, SchemaTag schema);
+
+    // Records must come in time order, throws std::invalid_argument otherwise.
+    void write(int64_t time_us, std::span<const uint8_t> payload);
+
+    // Appends the index and completes the header.
+    void close();
+};
+
+class TelemetryFile
+{
+public:
+
+    struct Record
+    {
+        int64_t time_us;
+        std::span<const uint8_t> payload;
+    };
+
+    // Maps the file, nothing is read until the records are looked up, so the
+    // recording can be much larger than the memory. Throws std::runtime_error
+    // when it cannot be mapped or is not a telemetry file.
+    explicit TelemetryFile(const std::string& path);
+
+    SchemaTag schema() const noexcept { return _schema; }
+    std::size_t max_payload_size() const noexcept { return _max_payload_size; }
+    bool empty() const noexcept { return _index.empty(); }
+    int64_t start_time_us() const noexcept { return _start_time_us; }
+    int64_t end_time_us() const noexcept { return _end_time_us; }
+
+    // Last record at or before time_us, nullopt before the first one. A
+    // binary search in the index, then at most TELEMETRY_INDEX_INTERVAL
+    // record headers: O(log n), payloads are returned in place.
+    std::optional<Record> find(int64_t time_us) const noexcept;
+
+private:
+
+    std::shared_ptr<const void> _mapping;
+    std::span<const uint8_t> _data;
+    std::size_t _records_end{ 0 };
+    SchemaTag _schema{};
+    std::size_t _max_payload_size{ 0 };
+    int64_t _start_time_us{ 0 };
+    int64_t _end_time_us{ 0 };
+    std::vector<std::pair<int64_t, uint64_t>> _index;
+
+    std::optional<Record> record_at(std::size_t offset) const noexcept;
+    bool load_index() noexcept;
+    void build_index();
+};
+
+} // metadata
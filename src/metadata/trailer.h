@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "byte_order.h"
+#include "crc32c.h"
+
+namespace metadata
+{
+
+// Every metadata block appended to a frame ends with a fixed-size footer:
+//
+//   [payload ...][payload_length:u32][version:u8][flags:u8][magic:u32]
+//
+// The payload stays at the start of the appended data, so readers that only
+// know the original pos_x/pos_y layout keep reading the same offsets. New
+// readers locate the footer from the tail in constant time and can skip a
+// payload they do not understand using payload_length.
+//
+// Several blocks may be appended to the same frame, each closed by its own
+// footer. They are read back from the tail: the block before a given one ends
+// right where its payload starts.
+//
+// With the CRC32C flag, the last 4 bytes of the payload are the big-endian
+// CRC32C of the bytes before them. BlockReader checks and strips it.
+
+constexpr uint32_t TRAILER_MAGIC = 0x4D434D44; // "MCMD"
+constexpr uint8_t TRAILER_VERSION = 1;
+constexpr std::size_t FOOTER_SIZE = 4 + 1 + 1 + 4;
+
+namespace flags
+{
+    constexpr uint8_t NONE = 0;
+    constexpr uint8_t DELTA = 1 << 0; // payload is DeltaEncoder output, see delta.h
+    constexpr uint8_t STATE_SYNC = 1 << 1; // payload is StateSyncEncoder output, see state_sync.h
+    constexpr uint8_t REDUNDANT = 1 << 2; // payload wraps the last samples, see redundancy.h
+    constexpr uint8_t FRAGMENT = 1 << 3; // block of message fragments, see fragment.h
+    constexpr uint8_t CRC32C = 1 << 4; // payload ends with its CRC32C
+    constexpr uint8_t ENCRYPTED = 1 << 5; // AES-GCM encrypted payload, see encryption.h
+    constexpr uint8_t COMPRESSED = 1 << 6; // LZ compressed payload, see compression.h (before encryption)
+    constexpr uint8_t SCHEMA = 1 << 7; // payload ends with a schema tag, see versioning.h
+}
+
+struct Trailer
+{
+    uint8_t version;
+    uint8_t flags;
+    std::span<const uint8_t> payload;
+};
+
+constexpr std::size_t CRC_SIZE = 4;
+
+// Closes the block that started at payload_offset in data.
+inline void append_footer(std::vector<uint8_t>& data, std::size_t payload_offset, uint8_t flags)
+{
+    const bool with_crc = flags & flags::CRC32C;
+    const auto offset = data.size();
+
+    data.resize(offset + (with_crc ? CRC_SIZE : 0) + FOOTER_SIZE);
+
+    auto* out = data.data() + offset;
+    if (with_crc)
+    {
+        const auto payload = std::span<const uint8_t>(data).subspan(payload_offset, offset - payload_offset);
+        store_be(out, crc32c(payload));
+        out += CRC_SIZE;
+    }
+
+    const auto payload_length = static_cast<uint32_t>(out - data.data() - payload_offset);
+    store_be(out, payload_length);
+    out[4] = TRAILER_VERSION;
+    out[5] = flags;
+    store_be(out + 6, TRAILER_MAGIC);
+}
+
+// Reads the footer at the end of data. Returns nullopt when data does not end
+// with a valid trailer (legacy publisher, truncated frame, ...).
+inline std::optional<Trailer> find_trailer(std::span<const uint8_t> data) noexcept
+{
+    if (data.size() < FOOTER_SIZE) return std::nullopt;
+
+    const auto* footer = data.data() + data.size() - FOOTER_SIZE;
+    if (load_be<uint32_t>(footer + 6) != TRAILER_MAGIC) return std::nullopt;
+
+    const auto payload_length = load_be<uint32_t>(footer);
+    if (payload_length > data.size() - FOOTER_SIZE) return std::nullopt;
+
+    return Trailer{
+        .version = footer[4],
+        .flags = footer[5],
+        .payload = data.subspan(data.size() - FOOTER_SIZE - payload_length, payload_length),
+    };
+}
+
+// Calls on_block(Trailer) for every block of data, last block first. Stops at
+// the first bytes that are not a valid block. Returns the number of blocks.
+template<typename Callback>
+std::size_t for_each_trailer(std::span<const uint8_t> data, Callback&& on_block)
+{
+    std::size_t count = 0;
+    while (auto trailer = find_trailer(data))
+    {
+        on_block(*trailer);
+        count++;
+        data = data.first(static_cast<std::size_t>(trailer->payload.data() - data.data()));
+    }
+    return count;
+}
+
+// Walks the blocks of a frame like for_each_trailer, checking the CRC of the
+// blocks that carry one. Corrupted blocks are skipped and counted; the
+// payload handed to on_block no longer contains the CRC.
+class BlockReader
+{
+    uint64_t _crc_failures{ 0 };
+
+public:
+
+    template<typename Callback>
+    std::size_t read(std::span<const uint8_t> data, Callback&& on_block)
+    {
+        return for_each_trailer(data, [&](Trailer trailer)
+        {
+            if (trailer.flags & flags::CRC32C)
+            {
+                if (!check_crc(trailer))
+                {
+                    _crc_failures++;
+                    return;
+                }
+            }
+            on_block(trailer);
+        });
+    }
+
+    uint64_t crc_failures() const noexcept { return _crc_failures; }
+
+private:
+
+    static bool check_crc(Trailer& trailer) noexcept
+    {
+        if (trailer.payload.size() < CRC_SIZE) return false;
+
+        const auto payload = trailer.payload.first(trailer.payload.size() - CRC_SIZE);
+        if (load_be<uint32_t>(payload.data() + payload.size()) != crc32c(payload)) return false;
+
+        trailer.payload = payload;
+        trailer.flags = static_cast<uint8_t>(trailer.flags & ~flags::CRC32C);
+        return true;
+    }
+};
+
+} // metadata
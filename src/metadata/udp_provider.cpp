@@ -0,0 +1,246 @@
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "byte_order.h"
+#include "object_snapshot.h"
+#include "provider.h"
+#include "quantized.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace metadata
+{
+
+namespace
+{
+
+#ifdef _WIN32
+using socket_t = SOCKET;
+constexpr socket_t INVALID_SOCKET_VALUE = INVALID_SOCKET;
+void close_socket(socket_t socket) { closesocket(socket); }
+#else
+using socket_t = int;
+constexpr socket_t INVALID_SOCKET_VALUE = -1;
+void close_socket(socket_t socket) { close(socket); }
+#endif
+
+// Ingests the positions of an external tracking process over UDP. Datagrams
+// carry one or more fixed-size big-endian records:
+//
+//   [object_id:u16][kind:u8][flags:u8][x:f32][y:f32]
+//
+// with x and y normalized to [0, 1]. A dedicated thread receives them in
+// batches (recvmmsg on Linux, one by one elsewhere), parses them in the
+// receive buffers and stores the latest record of each object in an
+// ObjectSnapshot. Each frame sends the objects updated in the last second,
+// with their ids, as a version 2 NORMALIZED_POSITION block.
+//
+// METADATA_UDP_ADDRESS : address to bind (default 127.0.0.1)
+// METADATA_UDP_PORT : port to bind (default 9000)
+// METADATA_UDP_DEADBAND : with METADATA_DEADBAND, smallest move of x or y,
+//                         normalized, that counts as a change (default 0)
+class UdpProvider : public MetadataProvider
+{
+    static constexpr std::size_t MAX_OBJECTS = 256;
+    static constexpr std::size_t RECORD_SIZE = 2 + 1 + 1 + 4 + 4;
+    static constexpr std::size_t BATCH = 64; // datagrams per receive call
+    static constexpr std::size_t MAX_DATAGRAM_SIZE = 1500;
+    static constexpr auto STALE_AFTER = std::chrono::seconds{ 1 };
+
+    ObjectSnapshot<MAX_OBJECTS> _objects;
+    QuantizedEncoder _encoder{ { .coordinate_bits = 16, .kind_bits = 8, .flag_bits = 8 } };
+    std::array<NormalizedPoint, MAX_OBJECTS> _points{};
+    std::array<uint16_t, MAX_OBJECTS> _ids{};
+    float _deadband;
+    std::size_t _count{ 0 };
+    std::vector<uint8_t> _buffers; // BATCH datagrams, only used by the thread
+    socket_t _socket{ INVALID_SOCKET_VALUE };
+    std::jthread _thread;
+
+public:
+
+    UdpProvider(const std::string& address, uint16_t port, float deadband) :
+        _deadband{ deadband },
+        _buffers(BATCH * MAX_DATAGRAM_SIZE)
+    {
+#ifdef _WIN32
+        static const bool winsock = [] { WSADATA wsa; return WSAStartup(MAKEWORD(2, 2), &wsa) == 0; }();
+        if (!winsock) throw std::runtime_error("Cannot initialize Winsock");
+#endif
+        _socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (_socket == INVALID_SOCKET_VALUE) throw std::runtime_error("Cannot create the metadata UDP socket");
+
+        // Room for bursts while the thread is descheduled.
+        int receive_buffer = 4 * 1024 * 1024;
+        setsockopt(_socket, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&receive_buffer), sizeof(receive_buffer));
+
+        // Wakes the thread up regularly to notice the stop request.
+#ifdef _WIN32
+        DWORD timeout = 100;
+#else
+        timeval timeout{ .tv_sec = 0, .tv_usec = 100'000 };
+#endif
+        setsockopt(_socket, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+
+        sockaddr_in local{};
+        local.sin_family = AF_INET;
+        local.sin_port = htons(port);
+        if (inet_pton(AF_INET, address.c_str(), &local.sin_addr) != 1
+            || bind(_socket, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) != 0)
+        {
+            close_socket(_socket);
+            throw std::runtime_error("Cannot bind the metadata UDP socket to " + address + ":" + std::to_string(port));
+        }
+
+        _thread = std::jthread([this](std::stop_token stop) { receive(stop); });
+    }
+
+    ~UdpProvider() override
+    {
+        _thread.request_stop();
+        _thread.join();
+        close_socket(_socket);
+    }
+
+    SchemaTag schema() const noexcept override { return { schemas::NORMALIZED_POSITION, QUANTIZED_IDS_SCHEMA_VERSION }; }
+
+    std::size_t max_size() const noexcept override { return _encoder.max_size_with_ids(MAX_OBJECTS); }
+
+    bool sample(std::chrono::steady_clock::time_point capture_time) override
+    {
+        _count = 0;
+        for (std::size_t id = 0; id < MAX_OBJECTS; ++id)
+        {
+            if (auto point = _objects.read(id, capture_time - STALE_AFTER))
+            {
+                _ids[_count] = static_cast<uint16_t>(id);
+                _points[_count++] = *point;
+            }
+        }
+        return _count > 0;
+    }
+
+    std::size_t serialize(std::span<uint8_t> out) override
+    {
+        return _encoder.encode(std::span(_points.data(), _count), std::span(_ids.data(), _count), out.data());
+    }
+
+    // Objects that came or went, or whose kind or flags changed, are changes;
+    // coordinates only when they moved by more than the deadband, so the
+    // jitter of a tracker does not defeat METADATA_DEADBAND.
+    bool changed(std::span<const uint8_t> sent, std::span<const uint8_t> payload) const override
+    {
+        if (_deadband <= 0 || sent.empty()) return MetadataProvider::changed(sent, payload);
+
+        std::array<uint16_t, MAX_OBJECTS> ids;
+        std::array<NormalizedPoint, MAX_OBJECTS> points;
+        std::size_t count = 0;
+        const bool sent_valid = decode_quantized_ids(sent, [&](uint16_t id, const NormalizedPoint& point)
+        {
+            if (count == MAX_OBJECTS) return;
+            ids[count] = id;
+            points[count++] = point;
+        });
+        if (!sent_valid) return true;
+
+        std::size_t i = 0;
+        bool moved = false;
+        const bool valid = decode_quantized_ids(payload, [&](uint16_t id, const NormalizedPoint& point)
+        {
+            moved = moved || i >= count || ids[i] != id || points[i].kind != point.kind || points[i].flags != point.flags
+                || std::abs(points[i].x - point.x) > _deadband || std::abs(points[i].y - point.y) > _deadband;
+            ++i;
+        });
+        return !valid || moved || i != count;
+    }
+
+private:
+
+    void receive(std::stop_token stop)
+    {
+#ifdef __linux__
+        std::array<mmsghdr, BATCH> messages{};
+        std::array<iovec, BATCH> vectors{};
+        for (std::size_t i = 0; i < BATCH; ++i)
+        {
+            vectors[i] = { _buffers.data() + i * MAX_DATAGRAM_SIZE, MAX_DATAGRAM_SIZE };
+            messages[i].msg_hdr.msg_iov = &vectors[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        while (!stop.stop_requested())
+        {
+            // Returns as soon as one datagram is there, with all those queued.
+            const int count = recvmmsg(_socket, messages.data(), BATCH, MSG_WAITFORONE, nullptr);
+            if (count <= 0) continue;
+
+            const auto now = std::chrono::steady_clock::now();
+            for (int i = 0; i < count; ++i)
+            {
+                parse({ _buffers.data() + static_cast<std::size_t>(i) * MAX_DATAGRAM_SIZE, messages[static_cast<std::size_t>(i)].msg_len }, now);
+            }
+        }
+#else
+        while (!stop.stop_requested())
+        {
+            const auto size = recv(_socket, reinterpret_cast<char*>(_buffers.data()), static_cast<int>(MAX_DATAGRAM_SIZE), 0);
+            if (size <= 0) continue;
+
+            parse({ _buffers.data(), static_cast<std::size_t>(size) }, std::chrono::steady_clock::now());
+        }
+#endif
+    }
+
+    // Datagrams that are not a whole number of records, and unknown object
+    // ids, are ignored.
+    void parse(std::span<const uint8_t> datagram, std::chrono::steady_clock::time_point now) noexcept
+    {
+        if (datagram.size() % RECORD_SIZE) return;
+
+        for (const auto* record = datagram.data(); record != datagram.data() + datagram.size(); record += RECORD_SIZE)
+        {
+            const NormalizedPoint point{
+                .x = load_be<float>(record + 4),
+                .y = load_be<float>(record + 8),
+                .kind = record[2],
+                .flags = record[3],
+            };
+            _objects.update(load_be<uint16_t>(record), point, now);
+        }
+    }
+};
+
+const ProviderRegistration registration("udp", []
+{
+    const auto address = get_env("METADATA_UDP_ADDRESS");
+    const auto port = get_env("METADATA_UDP_PORT");
+    const auto deadband = get_env("METADATA_UDP_DEADBAND");
+
+    return std::make_unique<UdpProvider>(address.empty() ? "127.0.0.1" : address,
+        port.empty() ? uint16_t{ 9000 } : static_cast<uint16_t>(std::stoul(port)),
+        deadband.empty() ? 0.0f : std::stof(deadband));
+});
+
+} // anonymous namespace
+
+} // metadata
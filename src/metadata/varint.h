@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+namespace metadata
+{
+
+// LEB128 varints with zigzag mapping for signed values, so that small
+// magnitudes of either sign take a single byte.
+
+constexpr std::size_t MAX_VARINT_SIZE = 10;
+
+constexpr uint64_t zigzag_encode(int64_t value) noexcept
+{
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+constexpr int64_t zigzag_decode(uint64_t value) noexcept
+{
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+constexpr std::size_t varint_size(uint64_t value) noexcept
+{
+    std::size_t n = 1;
+    while (value >= 0x80)
+    {
+        value >>= 7;
+        n++;
+    }
+    return n;
+}
+
+// Writes value at out, which must have room for MAX_VARINT_SIZE bytes.
+// Returns the number of bytes written.
+inline std::size_t write_varint(uint8_t* out, uint64_t value) noexcept
+{
+    std::size_t n = 0;
+    while (value >= 0x80)
+    {
+        out[n++] = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = static_cast<uint8_t>(value);
+    return n;
+}
+
+// Reads a varint at pos and advances it. Returns nullopt on truncated or
+// overlong input.
+inline std::optional<uint64_t> read_varint(std::span<const uint8_t> in, std::size_t& pos) noexcept
+{
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64 && pos < in.size(); shift += 7)
+    {
+        const uint8_t byte = in[pos++];
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+    return std::nullopt;
+}
+
+} // metadata
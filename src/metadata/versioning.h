@@ -0,0 +1,150 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "trailer.h"
+
+namespace metadata
+{
+
+// Blocks with the SCHEMA flag end with a 2 bytes schema tag:
+//
+//   [fields ...][schema_id:u8][schema_version:u8]
+//
+// The tag sits at the end so the position stays at offset 0 for the UE5
+// player. A new version of a schema only appends fields to the previous one:
+// a viewer that knows version N decodes the first fields of any version >= N
+// and skips the rest in O(1), since payload_length in the footer already gives
+// the end of the block. Blocks without the flag, and frames from a publisher
+// using the legacy layout, are version 1 of the position schema.
+//
+// The top bit of the version byte marks a stale block, one that repeats the
+// last value of a provider that missed its deadline (see async_provider.h),
+// so versions go up to 127. Viewers that predate the bit see a newer version
+// and decode the fields they know.
+
+namespace schemas
+{
+    constexpr uint8_t POSITION = 0; // pos_x/pos_y, see position.h
+    constexpr uint8_t NORMALIZED_POSITION = 1; // quantized [0, 1] points, see quantized.h
+    constexpr uint8_t SENSOR_BATCH = 2; // samples of a high-rate sensor, see sensor_batch.h
+    constexpr uint8_t CLOCK = 3; // publisher wall clock at capture, see clock_provider.cpp
+}
+
+constexpr std::size_t SCHEMA_TAG_SIZE = 2;
+constexpr uint8_t SCHEMA_STALE = 0x80;
+constexpr uint8_t MAX_SCHEMA_VERSION = 0x7F;
+
+struct SchemaTag
+{
+    uint8_t id;
+    uint8_t version;
+    bool stale{ false };
+};
+
+inline void append_schema_tag(std::vector<uint8_t>& data, SchemaTag tag)
+{
+    data.push_back(tag.id);
+    data.push_back(static_cast<uint8_t>(tag.version | (tag.stale ? SCHEMA_STALE : 0)));
+}
+
+// Removes the schema tag from a block. Blocks without the SCHEMA flag get the
+// legacy position tag. Returns nullopt when the payload is too short.
+inline std::optional<SchemaTag> split_schema_tag(Trailer& block) noexcept
+{
+    if (!(block.flags & flags::SCHEMA)) return SchemaTag{ schemas::POSITION, 1 };
+    if (block.payload.size() < SCHEMA_TAG_SIZE) return std::nullopt;
+
+    const auto* tag = block.payload.data() + block.payload.size() - SCHEMA_TAG_SIZE;
+    block.payload = block.payload.first(block.payload.size() - SCHEMA_TAG_SIZE);
+    block.flags = static_cast<uint8_t>(block.flags & ~flags::SCHEMA);
+    return SchemaTag{ tag[0], static_cast<uint8_t>(tag[1] & MAX_SCHEMA_VERSION), (tag[1] & SCHEMA_STALE) != 0 };
+}
+
+// Routes each block to the decoder registered for its schema id and version,
+// through a table indexed by id then version. A block with a newer version
+// than the newest registered one goes to the newest decoder, which reads the
+// fields it knows. The decoders get the block without its tag, with the other
+// flags (DELTA, REDUNDANT, ...) left for them to handle. Stale blocks are
+// decoded like the value they repeat and counted.
+//
+// The publisher tags a block before compressing then encrypting it, so the
+// tag of an ENCRYPTED or COMPRESSED block is only readable once the block is
+// opened: pass those through BlockOpener (frame_view.h) first.
+template<typename Context>
+class SchemaDispatcher
+{
+public:
+
+    using Decoder = bool (*)(Context& context, const Trailer& block);
+
+private:
+
+    std::array<std::vector<Decoder>, 256> _decoders; // [id][version - 1]
+    uint64_t _unknown{ 0 };
+    uint64_t _stale{ 0 };
+    uint64_t _sealed{ 0 };
+
+public:
+
+    // Registration allocates, decoding does not.
+    void add(uint8_t id, uint8_t version, Decoder decoder)
+    {
+        if (version == 0 || version > MAX_SCHEMA_VERSION) throw std::invalid_argument("Schema versions go from 1 to 127");
+
+        auto& versions = _decoders[id];
+        if (versions.size() < version) versions.resize(version, nullptr);
+        versions[version - 1] = decoder;
+    }
+
+    // Returns false for malformed blocks, unknown schemas and versions older
+    // than the registered ones. Fragment blocks are not schema blocks and are
+    // ignored without being counted. Blocks still encrypted or compressed are
+    // counted in sealed().
+    bool decode(Context& context, Trailer block)
+    {
+        if (block.flags & flags::FRAGMENT) return false;
+        if (block.flags & (flags::ENCRYPTED | flags::COMPRESSED))
+        {
+            _sealed++;
+            return false;
+        }
+
+        const auto tag = split_schema_tag(block);
+        if (!tag || tag->version == 0)
+        {
+            _unknown++;
+            return false;
+        }
+
+        if (tag->stale) _stale++;
+
+        const auto& versions = _decoders[tag->id];
+        const auto index = std::min<std::size_t>(tag->version, versions.size());
+        if (!index || !versions[index - 1])
+        {
+            _unknown++;
+            return false;
+        }
+
+        return versions[index - 1](context, block);
+    }
+
+    // Blocks not decoded because of their tag.
+    uint64_t unknown() const noexcept { return _unknown; }
+
+    // Stale blocks seen, the providers of the publisher are too slow.
+    uint64_t stale() const noexcept { return _stale; }
+
+    // Encrypted or compressed blocks passed without being opened.
+    uint64_t sealed() const noexcept { return _sealed; }
+};
+
+} // metadata
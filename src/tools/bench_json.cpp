@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "metadata/json_fields.h"
+#include "metadata/json_index.h"
+
+// Checks each structural index implementation (json_index.h) against a byte
+// by byte reference on random inputs made of the characters that matter
+// (quotes, backslash runs, newlines in strings, ...), then measures them and
+// the whole line conversion on newline-delimited tracker objects.
+//
+//   metadata-bench-json [cases] [iterations]
+//
+// Prints the best of several runs in MB/s, to leave out the scheduler noise,
+// and returns 1 when an implementation differs from the reference.
+
+namespace
+{
+
+constexpr int RUNS = 15;
+constexpr std::size_t MAX_CASE_SIZE = 300; // several blocks and a tail
+
+// The structural characters as json_index.h defines them, one byte at a
+// time. A backslash escapes the next byte wherever it is, which only
+// matters for quotes, and every newline ends the string it is in.
+std::vector<uint32_t> reference_index(std::string_view json)
+{
+    std::vector<uint32_t> offsets;
+    bool in_string = false;
+    bool escaped = false;
+    for (std::size_t i = 0; i < json.size(); ++i)
+    {
+        const char c = json[i];
+        const bool was_escaped = escaped;
+        escaped = c == '\\' && !was_escaped;
+
+        if (c == '\n')
+        {
+            in_string = false;
+            offsets.push_back(static_cast<uint32_t>(i));
+        }
+        else if (c == '"' && !was_escaped)
+        {
+            in_string = !in_string;
+            offsets.push_back(static_cast<uint32_t>(i));
+        }
+        else if (!in_string && std::string_view("{}[]:,").find(c) != std::string_view::npos)
+        {
+            offsets.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    return offsets;
+}
+
+// Returns the number of cases where implementation differs from the reference.
+uint64_t check(const char* implementation, int cases)
+{
+    static constexpr std::string_view ALPHABET = "\"\"\\\\\\\n{}[]:, a0";
+
+    std::mt19937_64 random{ 42 };
+    std::string json;
+    std::vector<uint32_t> offsets(MAX_CASE_SIZE);
+    uint64_t mismatches = 0;
+    for (int i = 0; i < cases; ++i)
+    {
+        json.resize(random() % MAX_CASE_SIZE + 1);
+        for (auto& c : json) c = ALPHABET[random() % ALPHABET.size()];
+
+        const auto count = metadata::index_json(json, offsets.data(), implementation);
+        const auto expected = reference_index(json);
+        if (!std::equal(offsets.begin(), offsets.begin() + static_cast<std::ptrdiff_t>(count), expected.begin(), expected.end()))
+        {
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+std::string tracker_lines(std::size_t size)
+{
+    std::string text;
+    for (uint32_t i = 0; text.size() < size; ++i)
+    {
+        text += R"({"x": 0.)" + std::to_string(i % 1000) + R"(, "y": 0.)" + std::to_string(i * 7 % 1000) + R"(, "id": )"
+            + std::to_string(i % 256) + R"(, "visible": true, "label": "car \"left\"", "box": [1, 2, 3, 4]})" + "\n";
+    }
+    return text;
+}
+
+template<typename Run>
+double megabytes_per_second(std::size_t size, int iterations, Run&& run)
+{
+    double best = 0;
+    for (int r = 0; r < RUNS; ++r)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) run();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::max(best, static_cast<double>(size) * iterations / elapsed.count() / 1e6);
+    }
+    return best;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    const int cases = argc > 1 ? std::stoi(argv[1]) : 200000;
+    const int iterations = argc > 2 ? std::stoi(argv[2]) : 20;
+
+    const auto text = tracker_lines(1 << 20);
+    std::vector<uint32_t> offsets(text.size());
+
+    bool correct = true;
+    for (const auto* implementation : metadata::json_index_implementations())
+    {
+        const auto mismatches = check(implementation, cases);
+        correct = correct && mismatches == 0;
+
+        uint64_t checksum = 0;
+        const auto index = megabytes_per_second(text.size(), iterations, [&]
+        {
+            checksum += metadata::index_json(text, offsets.data(), implementation);
+        });
+
+        std::cout << implementation << " : " << mismatches << " mismatches in " << cases << " random cases, index "
+            << index << " MB/s" << (checksum ? "" : " (empty)") << std::endl;
+    }
+
+    metadata::JsonConverter converter{ metadata::JsonFieldTable{ "x:f32,y:f32,id:u16,visible:u8" } };
+    const auto conversion = megabytes_per_second(text.size(), iterations, [&] { converter.convert(text); });
+    std::cout << "Conversion with " << metadata::json_index_implementation() << " : " << conversion << " MB/s, "
+        << converter.records() << " records" << std::endl;
+
+    return correct ? 0 : 1;
+}
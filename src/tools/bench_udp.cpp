@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "metadata/byte_order.h"
+#include "metadata/provider.h"
+#include "metadata/quantized.h"
+
+// Sends tracker datagrams over the loopback to the udp provider, received
+// with its recvmmsg batch path, and measures how many it takes per second
+// against the 100k datagrams/s target, then the latency from sendmmsg to
+// the value a frame would sample. Linux only.
+//
+//   metadata-bench-udp [datagrams] [rate]
+//
+// rate is in datagrams per second, 0 to send as fast as possible. The port
+// is METADATA_UDP_PORT, 9000 by default like the provider. Datagrams the
+// kernel dropped for lack of receive buffer are read from /proc/net/snmp,
+// so other UDP traffic on the host adds to them. Returns 2 when the target
+// is missed or datagrams were dropped.
+
+namespace
+{
+
+using clock = std::chrono::steady_clock;
+
+constexpr double TARGET_PER_SECOND = 100'000;
+constexpr std::size_t RECORD_SIZE = 2 + 1 + 1 + 4 + 4;
+constexpr std::size_t BATCH = 64; // datagrams per sendmmsg
+constexpr uint16_t MARKER_ID = 255; // last datagram of the throughput run
+constexpr uint16_t PROBE_ID = 254; // latency probes
+constexpr int PROBES = 1000;
+
+void write_record(uint8_t* out, uint16_t id, float x, float y)
+{
+    metadata::store_be(out, id);
+    out[2] = 1; // kind
+    out[3] = 0; // flags
+    metadata::store_be(out + 4, x);
+    metadata::store_be(out + 8, y);
+}
+
+// Udp RcvbufErrors of /proc/net/snmp, 0 when it cannot be read.
+uint64_t receive_buffer_errors()
+{
+    std::ifstream snmp("/proc/net/snmp");
+    std::string names, values;
+    while (std::getline(snmp, names) && std::getline(snmp, values))
+    {
+        if (!names.starts_with("Udp:")) continue;
+
+        std::istringstream name_fields(names), value_fields(values);
+        std::string name, value;
+        while (name_fields >> name && value_fields >> value)
+        {
+            if (name == "RcvbufErrors") return std::stoull(value);
+        }
+    }
+    return 0;
+}
+
+// Position of object id in the block the provider would send now.
+std::optional<metadata::NormalizedPoint> sample_object(metadata::MetadataProvider& provider, uint16_t id, std::vector<uint8_t>& block)
+{
+    if (!provider.sample(clock::now())) return std::nullopt;
+
+    block.resize(provider.max_size());
+    block.resize(provider.serialize(block));
+
+    std::optional<metadata::NormalizedPoint> found;
+    metadata::decode_quantized_ids(block, [&](uint16_t object, const metadata::NormalizedPoint& point)
+    {
+        if (object == id) found = point;
+    });
+    return found;
+}
+
+class Sender
+{
+    int _socket;
+    sockaddr_in _remote{};
+    std::vector<uint8_t> _records;
+    std::array<iovec, BATCH> _vectors{};
+    std::array<mmsghdr, BATCH> _messages{};
+
+public:
+
+    explicit Sender(uint16_t port) : _socket{ socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP) }, _records(BATCH * RECORD_SIZE)
+    {
+        if (_socket < 0) throw std::runtime_error("Cannot create the sender socket");
+
+        _remote.sin_family = AF_INET;
+        _remote.sin_port = htons(port);
+        _remote.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        for (std::size_t i = 0; i < BATCH; ++i)
+        {
+            _vectors[i] = { _records.data() + i * RECORD_SIZE, RECORD_SIZE };
+            _messages[i].msg_hdr.msg_iov = &_vectors[i];
+            _messages[i].msg_hdr.msg_iovlen = 1;
+            _messages[i].msg_hdr.msg_name = &_remote;
+            _messages[i].msg_hdr.msg_namelen = sizeof(_remote);
+        }
+    }
+
+    ~Sender() { close(_socket); }
+
+    // Sends count datagrams, one record each, numbered from first.
+    void send(uint64_t first, std::size_t count, uint16_t id_modulo)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const auto sequence = first + i;
+            write_record(_records.data() + i * RECORD_SIZE, static_cast<uint16_t>(sequence % id_modulo),
+                static_cast<float>(sequence % 1000) / 1000, 0.5f);
+        }
+        send_records(count);
+    }
+
+    void send_one(uint16_t id, float x)
+    {
+        write_record(_records.data(), id, x, 0.5f);
+        send_records(1);
+    }
+
+private:
+
+    void send_records(std::size_t count)
+    {
+        for (std::size_t sent = 0; sent < count;)
+        {
+            const int result = sendmmsg(_socket, _messages.data() + sent, static_cast<unsigned>(count - sent), 0);
+            if (result <= 0) throw std::runtime_error("sendmmsg failed");
+            sent += static_cast<std::size_t>(result);
+        }
+    }
+};
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    const uint64_t datagrams = argc > 1 ? std::stoull(argv[1]) : 1'000'000;
+    const double rate = argc > 2 ? std::stod(argv[2]) : 200'000;
+
+    if (metadata::get_env("METADATA_UDP_PORT").empty()) setenv("METADATA_UDP_PORT", "9000", 1);
+    const auto port = static_cast<uint16_t>(std::stoul(metadata::get_env("METADATA_UDP_PORT")));
+
+    auto provider = metadata::ProviderRegistry::instance().create("udp");
+    Sender sender{ port };
+    std::vector<uint8_t> block;
+
+    // Throughput: paced batches, then a marker the provider must have seen.
+    const auto errors = receive_buffer_errors();
+    const auto start = clock::now();
+    for (uint64_t sent = 0; sent < datagrams;)
+    {
+        const auto count = static_cast<std::size_t>(std::min<uint64_t>(BATCH, datagrams - sent));
+        sender.send(sent, count, PROBE_ID);
+        sent += count;
+
+        if (rate > 0) std::this_thread::sleep_until(start + std::chrono::duration<double>(static_cast<double>(sent) / rate));
+    }
+    const std::chrono::duration<double> send_time = clock::now() - start;
+
+    sender.send_one(MARKER_ID, 1);
+    const auto deadline = clock::now() + std::chrono::seconds{ 1 };
+    while (!sample_object(*provider, MARKER_ID, block) && clock::now() < deadline) {}
+    const std::chrono::duration<double> receive_time = clock::now() - start;
+
+    const auto dropped = std::min(receive_buffer_errors() - errors, datagrams);
+    const auto per_second = static_cast<double>(datagrams - dropped) / receive_time.count();
+
+    std::cout << "Sent " << datagrams << " datagrams at " << static_cast<double>(datagrams) / send_time.count()
+        << " /s, received " << per_second << " /s, dropped " << dropped << std::endl;
+
+    // Latency: one probe at a time, until the provider samples its value.
+    std::vector<double> latencies;
+    for (int probe = 0; probe < PROBES; ++probe)
+    {
+        const auto x = static_cast<float>(probe % 2 ? probe : PROBES - probe) / PROBES;
+        const auto sent = clock::now();
+        sender.send_one(PROBE_ID, x);
+
+        const auto probe_deadline = sent + std::chrono::milliseconds{ 100 };
+        for (auto now = sent; now < probe_deadline; now = clock::now())
+        {
+            const auto point = sample_object(*provider, PROBE_ID, block);
+            if (point && std::abs(point->x - x) < 1e-4f)
+            {
+                latencies.push_back(std::chrono::duration<double, std::micro>(clock::now() - sent).count());
+                break;
+            }
+        }
+    }
+
+    if (!latencies.empty())
+    {
+        std::sort(latencies.begin(), latencies.end());
+        std::cout << "Latency over " << latencies.size() << " probes : median " << latencies[latencies.size() / 2]
+            << " us, p99 " << latencies[latencies.size() * 99 / 100] << " us, max " << latencies.back() << " us" << std::endl;
+    }
+
+    const bool met = per_second >= TARGET_PER_SECOND && dropped == 0;
+    std::cout << (met ? "Meets" : "Misses") << " the " << TARGET_PER_SECOND << " datagrams/s target" << std::endl;
+    return met ? 0 : 2;
+}
@@ -0,0 +1,58 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "metadata/compression.h"
+
+// Trains a metadata compression dictionary from recorded payloads, one
+// payload per file.
+//
+//   metadata-dict-trainer <output> <id> <max_size> <payload files...>
+
+std::vector<uint8_t> read_file(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) throw std::runtime_error("Cannot open " + path);
+
+    return { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 5)
+    {
+        std::cerr << "Usage: " << argv[0] << " <output> <id> <max_size> <payload files...>" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        const auto id = static_cast<uint32_t>(std::stoul(argv[2]));
+        const auto max_size = std::stoul(argv[3]);
+        if (id == 0) throw std::runtime_error("Dictionary id 0 is reserved.");
+
+        std::vector<std::vector<uint8_t>> samples;
+        std::size_t total = 0;
+        for (int i = 4; i < argc; ++i)
+        {
+            samples.push_back(read_file(argv[i]));
+            total += samples.back().size();
+        }
+
+        metadata::Dictionary dictionary{ id, metadata::train_dictionary(samples, max_size) };
+        metadata::save_dictionary(argv[1], dictionary);
+
+        std::cout << "Trained a " << dictionary.bytes.size() << " bytes dictionary from "
+            << samples.size() << " payloads (" << total << " bytes)" << std::endl;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}